@@ -71,7 +71,7 @@ struct Array : public BaseAllocation {
 
             T*	newData	= static_cast<T*>(calloc(reserved, sizeof(T)));
             for( size_t i = 0; i < count; ++i )
-                new(&(newData[i])) T(data[i]);
+                new(&(newData[i])) T(move(data[i]));
 
             // remove old data
             for( size_t i = 0; i < count; ++i )
@@ -86,6 +86,15 @@ struct Array : public BaseAllocation {
         ++count;
     }
 
+    void
+    pushBack(T&& t)	{
+        if( count == reserved )
+            reserve((reserved == 0) ? static_cast<size_t>(MIN_VEC_RES_SIZE) : (reserved * 2));
+
+        new(&(data[count])) T(move(t));
+        ++count;
+    }
+
     void
     popBack() {
         if( count ) {
@@ -132,6 +141,31 @@ struct Array : public BaseAllocation {
         count	= 0;
     }
 
+    ///
+    /// make sure the array can hold at least n elements without reallocating
+    /// @param n the number of elements to reserve room for
+    ///
+    void
+    reserve(size_t n)	{
+        if( n <= reserved )
+            return;
+
+        T*	newData	= static_cast<T*>(calloc(n, sizeof(T)));
+        assert(newData != 0);
+        for( size_t i = 0; i < count; ++i )
+            new(&(newData[i])) T(move(data[i]));
+
+        // remove old data
+        for( size_t i = 0; i < count; ++i )
+            (data[i]).~T();
+        free(data);
+
+        data		= newData;
+        reserved	= n;
+    }
+
+    size_t		capacity() const		{ return reserved;	}
+
     void
     resize(size_t newSize)	{
         if( newSize > reserved ) {
@@ -142,7 +176,7 @@ struct Array : public BaseAllocation {
             assert(newData != 0);
             for( size_t i = 0; i < count; ++i )
             {
-                new(&(newData[i])) T(data[i]);
+                new(&(newData[i])) T(move(data[i]));
             }
 
             // remove old data
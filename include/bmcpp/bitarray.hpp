@@ -0,0 +1,289 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "array.hpp"
+
+#include <cstdint>
+
+#if defined(__AVX2__) || defined(__BMI2__)
+#include <immintrin.h>
+#endif
+
+namespace BmCpp {
+
+namespace Detail {
+
+///
+/// set bits in n words. with AVX2 this is Mula's nibble lookup: 32 bytes at a time go
+/// through a 16 entry pshufb table and the byte counts are folded with psadbw, which
+/// beats one popcnt per word once the range is more than a few cache lines long
+///
+inline size_t
+popcountWords(const uint64_t* w, size_t n) {
+    size_t	count	= 0;
+    size_t	i	= 0;
+#if defined(__AVX2__)
+    if( n >= 16 ) {
+        const __m256i	lookup	= _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                   0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i	low	= _mm256_set1_epi8(0x0f);
+        __m256i		acc	= _mm256_setzero_si256();
+        while( i + 4 <= n ) {
+            // a byte counter takes at most 8 per step, flush before it can overflow
+            __m256i	local	= _mm256_setzero_si256();
+            for( int k = 0; k < 31 && i + 4 <= n; ++k, i += 4 ) {
+                __m256i	v	= _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w + i));
+                __m256i	lo	= _mm256_and_si256(v, low);
+                __m256i	hi	= _mm256_and_si256(_mm256_srli_epi16(v, 4), low);
+                local	= _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, lo));
+                local	= _mm256_add_epi8(local, _mm256_shuffle_epi8(lookup, hi));
+            }
+            acc	= _mm256_add_epi64(acc, _mm256_sad_epu8(local, _mm256_setzero_si256()));
+        }
+        count	= size_t(_mm256_extract_epi64(acc, 0)) + size_t(_mm256_extract_epi64(acc, 1)) +
+                  size_t(_mm256_extract_epi64(acc, 2)) + size_t(_mm256_extract_epi64(acc, 3));
+    }
+#endif
+    for( ; i < n; ++i )
+        count	+= size_t(__builtin_popcountll(w[i]));
+    return count;
+}
+
+///
+/// @return the position of the k-th (from 0) set bit of w, k < popcount(w)
+///
+inline unsigned
+selectInWord(uint64_t w, unsigned k) {
+#if defined(__BMI2__)
+    return unsigned(__builtin_ctzll(_pdep_u64(uint64_t(1) << k, w)));
+#else
+    for( ; k; --k )
+        w	&= w - 1;
+    return unsigned(__builtin_ctzll(w));
+#endif
+}
+
+}	// namespace Detail
+
+///
+/// dynamically sized array of bits packed in 64 bit words. bits past size() in the
+/// last word are always zero, so counts and bulk operations work on whole words
+///
+struct BitArray : public BaseAllocation
+{
+    enum
+    {
+        WORD_BITS	= 64
+    };
+
+    BitArray() : bits(0)	{}
+
+    explicit BitArray(size_t n, bool value = false) : bits(0)	{ resize(n, value); }
+
+    BitArray(const BitArray& other) : words(other.words), bits(other.bits)	{}
+    BitArray(BitArray&& other) : words(move(other.words)), bits(other.bits)	{ other.bits	= 0; }
+
+    BitArray&
+    operator = (const BitArray& other) {
+        if( this != &other ) {
+            words	= other.words;
+            bits	= other.bits;
+        }
+        return *this;
+    }
+
+    BitArray&
+    operator = (BitArray&& other) {
+        words	= move(other.words);
+        bits	= other.bits;
+        other.bits	= 0;
+        return *this;
+    }
+
+    size_t		size() const		{ return bits;	}
+    size_t		wordCount() const	{ return words.size();	}
+    const uint64_t*	data() const		{ return words.get();	}
+
+    ///
+    /// grow or shrink to n bits, new bits take value
+    ///
+    void
+    resize(size_t n, bool value = false) {
+        size_t	old	= bits;
+        words.resize((n + WORD_BITS - 1) / WORD_BITS);	// new words come in zeroed
+        bits	= n;
+        if( value && n > old ) {
+            size_t	i	= old;
+            for( ; i < n && i % WORD_BITS; ++i )
+                set(i);
+            // whole words from here; if n was reached inside the old last word it is done
+            for( size_t w = (i + WORD_BITS - 1) / WORD_BITS; w < words.size(); ++w )
+                words[w]	= ~uint64_t(0);
+        }
+        trim();
+    }
+
+    bool	test(size_t i) const	{ assert(i < bits); return (words[i / WORD_BITS] >> (i % WORD_BITS)) & 1;	}
+    void	set(size_t i)		{ assert(i < bits); words[i / WORD_BITS]	|= uint64_t(1) << (i % WORD_BITS);	}
+    void	clear(size_t i)		{ assert(i < bits); words[i / WORD_BITS]	&= ~(uint64_t(1) << (i % WORD_BITS));	}
+    void	flip(size_t i)		{ assert(i < bits); words[i / WORD_BITS]	^= uint64_t(1) << (i % WORD_BITS);	}
+
+    void
+    set(size_t i, bool value) {
+        uint64_t	m	= uint64_t(1) << (i % WORD_BITS);
+        uint64_t&	w	= words[i / WORD_BITS];
+        assert(i < bits);
+        w	= (w & ~m) | ((uint64_t(0) - uint64_t(value)) & m);
+    }
+
+    void
+    setAll() {
+        for( size_t w = 0; w < words.size(); ++w )
+            words[w]	= ~uint64_t(0);
+        trim();
+    }
+
+    void
+    clearAll() {
+        for( size_t w = 0; w < words.size(); ++w )
+            words[w]	= 0;
+    }
+
+    void
+    flipAll() {
+        for( size_t w = 0; w < words.size(); ++w )
+            words[w]	= ~words[w];
+        trim();
+    }
+
+    ///
+    /// @return the number of set bits
+    ///
+    size_t	count() const	{ return Detail::popcountWords(words.get(), words.size());	}
+
+    bool
+    any() const {
+        for( size_t w = 0; w < words.size(); ++w )
+            if( words[w] )
+                return true;
+        return false;
+    }
+
+    bool	none() const	{ return !any();	}
+
+    ///
+    /// @return the number of set bits in [0, i)
+    ///
+    size_t
+    rank(size_t i) const {
+        assert(i <= bits);
+        size_t	r	= Detail::popcountWords(words.get(), i / WORD_BITS);
+        if( i % WORD_BITS )
+            r	+= size_t(__builtin_popcountll(words[i / WORD_BITS] & ((uint64_t(1) << (i % WORD_BITS)) - 1)));
+        return r;
+    }
+
+    ///
+    /// @return the position of the k-th (from 0) set bit, or size() if there are not
+    /// that many
+    ///
+    size_t
+    select(size_t k) const {
+        for( size_t w = 0; w < words.size(); ++w ) {
+            size_t	c	= size_t(__builtin_popcountll(words[w]));
+            if( k < c )
+                return w * WORD_BITS + Detail::selectInWord(words[w], unsigned(k));
+            k	-= c;
+        }
+        return bits;
+    }
+
+    ///
+    /// @return the position of the first set bit at or after i, or size()
+    ///
+    size_t
+    findNext(size_t i) const {
+        if( i >= bits )
+            return bits;
+        size_t		w	= i / WORD_BITS;
+        uint64_t	cur	= words[w] & (~uint64_t(0) << (i % WORD_BITS));
+        while( !cur ) {
+            if( ++w == words.size() )
+                return bits;
+            cur	= words[w];
+        }
+        return w * WORD_BITS + size_t(__builtin_ctzll(cur));
+    }
+
+    size_t	findFirst() const	{ return findNext(0);	}
+
+    ///
+    /// word at a time boolean operations, both sides must have the same size()
+    ///
+    BitArray&
+    operator &= (const BitArray& o) {
+        assert(o.bits == bits);
+        uint64_t*	d	= words.get();
+        const uint64_t*	s	= o.words.get();
+        for( size_t w = 0, n = words.size(); w < n; ++w )
+            d[w]	&= s[w];
+        return *this;
+    }
+
+    BitArray&
+    operator |= (const BitArray& o) {
+        assert(o.bits == bits);
+        uint64_t*	d	= words.get();
+        const uint64_t*	s	= o.words.get();
+        for( size_t w = 0, n = words.size(); w < n; ++w )
+            d[w]	|= s[w];
+        return *this;
+    }
+
+    BitArray&
+    operator ^= (const BitArray& o) {
+        assert(o.bits == bits);
+        uint64_t*	d	= words.get();
+        const uint64_t*	s	= o.words.get();
+        for( size_t w = 0, n = words.size(); w < n; ++w )
+            d[w]	^= s[w];
+        return *this;
+    }
+
+    ///
+    /// clear every bit that is set in o
+    ///
+    BitArray&
+    andNot(const BitArray& o) {
+        assert(o.bits == bits);
+        uint64_t*	d	= words.get();
+        const uint64_t*	s	= o.words.get();
+        for( size_t w = 0, n = words.size(); w < n; ++w )
+            d[w]	&= ~s[w];
+        return *this;
+    }
+
+    bool
+    operator == (const BitArray& o) const {
+        if( o.bits != bits )
+            return false;
+        for( size_t w = 0; w < words.size(); ++w )
+            if( words[w] != o.words[w] )
+                return false;
+        return true;
+    }
+
+    bool	operator != (const BitArray& o) const	{ return !(*this == o);	}
+
+private:
+    void
+    trim() {
+        if( bits % WORD_BITS )
+            words[words.size() - 1]	&= (uint64_t(1) << (bits % WORD_BITS)) - 1;
+    }
+
+    Array<uint64_t>	words;
+    size_t		bits;
+};
+
+}	// namespace BmCpp
@@ -0,0 +1,624 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "array.hpp"
+#include "lambda.hpp"
+#include "sort.hpp"
+
+#include <cstdint>
+
+namespace BmCpp {
+
+///
+/// ordered map as a B+ tree. nodes are about NODE_BYTES wide so a lookup touches a
+/// handful of cache lines per level, and every key/value pair lives in a leaf. leaves
+/// are chained both ways, so range scans walk them without going back up the tree.
+/// K and V must be default constructible and movable; pointers returned by set() and
+/// find() and iterators stay valid only until the next set() or remove()
+///
+template<typename K, typename V, typename Cmp = Less<K>>
+struct BTreeMap : public BaseAllocation, private NonCopyable
+{
+    enum
+    {
+        NODE_BYTES	= 512,
+        LEAF_MAX	= (NODE_BYTES / (sizeof(K) + sizeof(V))) > 4 ? (NODE_BYTES / (sizeof(K) + sizeof(V))) : 4,
+        LEAF_MIN	= LEAF_MAX / 2,
+        INNER_MAX	= (NODE_BYTES / (sizeof(K) + sizeof(void*))) > 4 ? (NODE_BYTES / (sizeof(K) + sizeof(void*))) : 4,
+        INNER_MIN	= INNER_MAX / 2
+    };
+
+private:
+    struct Node : public BaseAllocation
+    {
+        explicit Node(bool leaf) : count(0), leaf(leaf)	{}
+
+        uint32_t	count;	///< keys in this node
+        bool		leaf;
+    };
+
+    struct Leaf : public Node
+    {
+        Leaf() : Node(true), prev(nullptr), next(nullptr)	{}
+
+        Leaf*	prev;
+        Leaf*	next;
+        K	keys[LEAF_MAX];
+        V	values[LEAF_MAX];
+    };
+
+    ///
+    /// keys[i] separates children[i] (keys below it) from children[i + 1]
+    ///
+    struct Inner : public Node
+    {
+        Inner() : Node(false)	{}
+
+        K	keys[INNER_MAX];
+        Node*	children[INNER_MAX + 1];
+    };
+
+public:
+    ///
+    /// position of one entry, or end() past the last one. end() remembers the last
+    /// leaf, so --end() is the last entry (of a non empty map)
+    ///
+    struct Iterator
+    {
+        Iterator() : leaf(nullptr), last(nullptr), index(0)	{}
+
+        const K&	key() const	{ return leaf->keys[index];	}
+        V&		value() const	{ return leaf->values[index];	}
+
+        Iterator&
+        operator ++ () {
+            if( ++index == leaf->count ) {
+                last	= leaf;
+                leaf	= leaf->next;
+                index	= 0;
+            }
+            return *this;
+        }
+
+        Iterator&
+        operator -- () {
+            if( !leaf ) {
+                assert(last != nullptr && "decrementing end() of an empty map");
+                leaf	= last;
+                index	= leaf->count;
+            } else if( index == 0 ) {
+                leaf	= leaf->prev;
+                index	= leaf->count;
+            }
+            --index;
+            return *this;
+        }
+
+        bool	operator == (const Iterator& o) const	{ return leaf == o.leaf && index == o.index;	}
+        bool	operator != (const Iterator& o) const	{ return !(*this == o);	}
+
+    private:
+        Iterator(Leaf* leaf, Leaf* last, uint32_t index) : leaf(leaf), last(last), index(index) {
+            if( leaf && index == leaf->count ) {
+                this->last	= leaf;
+                this->leaf	= leaf->next;
+                this->index	= 0;
+            }
+        }
+
+        Leaf*		leaf;
+        Leaf*		last;	///< the leaf before this one, only needed by --end()
+        uint32_t	index;
+
+        friend struct BTreeMap;
+    };
+
+    BTreeMap() : root(nullptr), head(nullptr), tail(nullptr), size(0)	{}
+    explicit BTreeMap(const Cmp& less) : root(nullptr), head(nullptr), tail(nullptr), size(0), less(less)	{}
+
+    BTreeMap(BTreeMap&& other) : root(other.root), head(other.head), tail(other.tail), size(other.size), less(other.less) {
+        other.root	= nullptr;
+        other.head	= nullptr;
+        other.tail	= nullptr;
+        other.size	= 0;
+    }
+
+    ~BTreeMap()	{ reset(); }
+
+    BTreeMap&
+    operator = (BTreeMap&& other) {
+        if( this != &other ) {
+            reset();
+            root	= other.root;
+            head	= other.head;
+            tail	= other.tail;
+            size	= other.size;
+            less	= other.less;
+            other.root	= nullptr;
+            other.head	= nullptr;
+            other.tail	= nullptr;
+            other.size	= 0;
+        }
+        return *this;
+    }
+
+    ///
+    /// remove everything
+    ///
+    void
+    reset() {
+        if( root )
+            destroy(root);
+        root	= nullptr;
+        head	= nullptr;
+        tail	= nullptr;
+        size	= 0;
+    }
+
+    size_t	count() const	{ return size;	}
+
+    ///
+    /// insert or overwrite
+    /// @return where the value now lives
+    ///
+    V*
+    set(K key, V value) {
+        if( !root ) {
+            Leaf*	l	= new Leaf();
+            root	= head	= tail	= l;
+        }
+
+        K	splitKey;
+        Node*	splitNode	= nullptr;
+        V*	v		= insert(root, key, value, splitKey, splitNode);
+        if( splitNode ) {
+            Inner*	r	= new Inner();
+            r->keys[0]	= move(splitKey);
+            r->children[0]	= root;
+            r->children[1]	= splitNode;
+            r->count	= 1;
+            root	= r;
+        }
+        return v;
+    }
+
+    ///
+    /// @return the value for key or nullptr
+    ///
+    V*
+    find(const K& key) const {
+        if( !root )
+            return nullptr;
+        Leaf*	l	= findLeaf(key);
+        size_t	i	= BmCpp::lowerBound(l->keys, l->count, key, less);
+        return (i < l->count && !less(key, l->keys[i])) ? &l->values[i] : nullptr;
+    }
+
+    bool	contains(const K& key) const	{ return find(key) != nullptr;	}
+
+    ///
+    /// @return true if key was there
+    ///
+    bool
+    remove(const K& key) {
+        if( !root || !erase(root, key) )
+            return false;
+
+        if( !root->leaf && root->count == 0 ) {
+            // the root lost its last separator, its only child takes over
+            Inner*	r	= static_cast<Inner*>(root);
+            root	= r->children[0];
+            delete r;
+        } else if( root->leaf && root->count == 0 ) {
+            delete static_cast<Leaf*>(root);
+            root	= head	= tail	= nullptr;
+        }
+        return true;
+    }
+
+    Iterator	begin() const	{ return Iterator(head, nullptr, 0);	}
+    Iterator	end() const	{ return Iterator(nullptr, tail, 0);	}
+
+    ///
+    /// @return the first entry whose key is not less than key
+    ///
+    Iterator
+    lowerBound(const K& key) const {
+        if( !root )
+            return end();
+        Leaf*	l	= findLeaf(key);
+        return Iterator(l, nullptr, uint32_t(BmCpp::lowerBound(l->keys, l->count, key, less)));
+    }
+
+    ///
+    /// @return the first entry whose key is greater than key
+    ///
+    Iterator
+    upperBound(const K& key) const {
+        if( !root )
+            return end();
+        Leaf*	l	= findLeaf(key);
+        return Iterator(l, nullptr, uint32_t(BmCpp::upperBound(l->keys, l->count, key, less)));
+    }
+
+    ///
+    /// call fn on every entry in key order
+    ///
+    void
+    foreach(FunctionRef<void(const K&, V*)> fn) {
+        for( Leaf* l = head; l; l = l->next )
+            for( uint32_t i = 0; i < l->count; ++i )
+                fn(l->keys[i], &l->values[i]);
+    }
+
+    void
+    foreach(FunctionRef<void(const K&, const V&)> fn) const {
+        for( Leaf* l = head; l; l = l->next )
+            for( uint32_t i = 0; i < l->count; ++i )
+                fn(l->keys[i], l->values[i]);
+    }
+
+    ///
+    /// call fn on the entries with lo <= key < hi, in key order
+    ///
+    void
+    range(const K& lo, const K& hi, FunctionRef<void(const K&, const V&)> fn) const {
+        for( Iterator it = lowerBound(lo); it != end() && less(it.key(), hi); ++it )
+            fn(it.key(), it.value());
+    }
+
+    ///
+    /// replace the contents with n entries whose keys are strictly increasing. leaves
+    /// are filled left to right and the levels above built bottom up, in O(n)
+    ///
+    void
+    bulkLoad(const K* keys, const V* values, size_t n) {
+        reset();
+        if( n == 0 )
+            return;
+
+        // full leaves, except that the last two share what is left so neither underflows
+        Array<Node*>	level;
+        size_t		i	= 0;
+        while( i < n ) {
+            size_t	left	= n - i;
+            size_t	take	= left > size_t(LEAF_MAX) ? size_t(LEAF_MAX) : left;
+            if( left > size_t(LEAF_MAX) && left - LEAF_MAX < size_t(LEAF_MIN) )
+                take	= left / 2;
+
+            Leaf*	l	= new Leaf();
+            for( size_t j = 0; j < take; ++j, ++i ) {
+                assert(i == 0 || less(keys[i - 1], keys[i]));
+                l->keys[j]	= keys[i];
+                l->values[j]	= values[i];
+            }
+            l->count	= uint32_t(take);
+            l->prev		= tail;
+            if( tail )
+                tail->next	= l;
+            else
+                head	= l;
+            tail	= l;
+            level.pushBack(l);
+        }
+        size	= n;
+
+        // separators are the smallest key under each child
+        while( level.size() > 1 ) {
+            Array<Node*>	up;
+            size_t		c	= 0;
+            while( c < level.size() ) {
+                size_t	left	= level.size() - c;
+                size_t	take	= left > size_t(INNER_MAX + 1) ? size_t(INNER_MAX + 1) : left;
+                if( left > size_t(INNER_MAX + 1) && left - (INNER_MAX + 1) < size_t(INNER_MIN + 1) )
+                    take	= left / 2;
+
+                Inner*	in	= new Inner();
+                for( size_t j = 0; j < take; ++j, ++c ) {
+                    in->children[j]	= level[c];
+                    if( j )
+                        in->keys[j - 1]	= minKey(level[c]);
+                }
+                in->count	= uint32_t(take - 1);
+                up.pushBack(in);
+            }
+            level	= move(up);
+        }
+        root	= level[0];
+    }
+
+private:
+    Leaf*
+    findLeaf(const K& key) const {
+        Node*	n	= root;
+        while( !n->leaf ) {
+            Inner*	in	= static_cast<Inner*>(n);
+            n	= in->children[BmCpp::upperBound(in->keys, in->count, key, less)];
+        }
+        return static_cast<Leaf*>(n);
+    }
+
+    static const K&
+    minKey(Node* n) {
+        while( !n->leaf )
+            n	= static_cast<Inner*>(n)->children[0];
+        return static_cast<Leaf*>(n)->keys[0];
+    }
+
+    void
+    destroy(Node* n) {
+        if( n->leaf ) {
+            delete static_cast<Leaf*>(n);
+            return;
+        }
+        Inner*	in	= static_cast<Inner*>(n);
+        for( uint32_t i = 0; i <= in->count; ++i )
+            destroy(in->children[i]);
+        delete in;
+    }
+
+    ///
+    /// insert into the subtree at n. when n had to split, the new right sibling and the
+    /// separator to put in front of it are returned through splitKey / splitNode
+    ///
+    V*
+    insert(Node* n, K& key, V& value, K& splitKey, Node*& splitNode) {
+        if( n->leaf ) {
+            Leaf*	l	= static_cast<Leaf*>(n);
+            size_t	i	= BmCpp::lowerBound(l->keys, l->count, key, less);
+            if( i < l->count && !less(key, l->keys[i]) ) {
+                l->values[i]	= move(value);
+                return &l->values[i];
+            }
+
+            if( l->count == LEAF_MAX ) {
+                Leaf*	r	= splitLeaf(l);
+                splitKey	= r->keys[0];
+                splitNode	= r;
+                if( i > l->count ) {
+                    i	-= l->count;
+                    l	= r;
+                }
+            }
+
+            for( size_t j = l->count; j > i; --j ) {
+                l->keys[j]	= move(l->keys[j - 1]);
+                l->values[j]	= move(l->values[j - 1]);
+            }
+            l->keys[i]	= move(key);
+            l->values[i]	= move(value);
+            ++l->count;
+            ++size;
+            return &l->values[i];
+        }
+
+        Inner*	in	= static_cast<Inner*>(n);
+        size_t	idx	= BmCpp::upperBound(in->keys, in->count, key, less);
+        K	childKey;
+        Node*	childSplit	= nullptr;
+        V*	v	= insert(in->children[idx], key, value, childKey, childSplit);
+        if( !childSplit )
+            return v;
+
+        if( in->count == INNER_MAX ) {
+            size_t	mid	= INNER_MAX / 2;
+            Inner*	r	= new Inner();
+            for( size_t j = mid + 1; j < INNER_MAX; ++j )
+                r->keys[j - mid - 1]	= move(in->keys[j]);
+            for( size_t j = mid + 1; j <= INNER_MAX; ++j )
+                r->children[j - mid - 1]	= in->children[j];
+            r->count	= uint32_t(INNER_MAX - mid - 1);
+            in->count	= uint32_t(mid);
+            splitKey	= move(in->keys[mid]);
+            for( size_t j = mid; j < INNER_MAX; ++j )
+                in->keys[j]	= K();
+            splitNode	= r;
+            if( idx > mid ) {
+                idx	-= mid + 1;
+                in	= r;
+            }
+        }
+
+        for( size_t j = in->count; j > idx; --j ) {
+            in->keys[j]		= move(in->keys[j - 1]);
+            in->children[j + 1]	= in->children[j];
+        }
+        in->keys[idx]		= move(childKey);
+        in->children[idx + 1]	= childSplit;
+        ++in->count;
+        return v;
+    }
+
+    Leaf*
+    splitLeaf(Leaf* l) {
+        Leaf*	r	= new Leaf();
+        size_t	half	= l->count / 2;
+        for( size_t j = half; j < l->count; ++j ) {
+            r->keys[j - half]	= move(l->keys[j]);
+            r->values[j - half]	= move(l->values[j]);
+        }
+        r->count	= uint32_t(l->count - half);
+        for( size_t j = half; j < l->count; ++j )
+            clearSlot(l, j);
+        l->count	= uint32_t(half);
+
+        r->prev	= l;
+        r->next	= l->next;
+        if( l->next )
+            l->next->prev	= r;
+        else
+            tail	= r;
+        l->next	= r;
+        return r;
+    }
+
+    ///
+    /// remove key from the subtree at n, children left under their minimum on the way
+    /// back up are refilled from a sibling or merged into one
+    ///
+    bool
+    erase(Node* n, const K& key) {
+        if( n->leaf ) {
+            Leaf*	l	= static_cast<Leaf*>(n);
+            size_t	i	= BmCpp::lowerBound(l->keys, l->count, key, less);
+            if( i == l->count || less(key, l->keys[i]) )
+                return false;
+            for( size_t j = i + 1; j < l->count; ++j ) {
+                l->keys[j - 1]		= move(l->keys[j]);
+                l->values[j - 1]	= move(l->values[j]);
+            }
+            --l->count;
+            clearSlot(l, l->count);
+            --size;
+            return true;
+        }
+
+        Inner*	in	= static_cast<Inner*>(n);
+        size_t	idx	= BmCpp::upperBound(in->keys, in->count, key, less);
+        if( !erase(in->children[idx], key) )
+            return false;
+
+        Node*	child	= in->children[idx];
+        if( child->count < uint32_t(child->leaf ? LEAF_MIN : INNER_MIN) )
+            rebalance(in, idx);
+        return true;
+    }
+
+    void
+    rebalance(Inner* parent, size_t idx) {
+        Node*	child	= parent->children[idx];
+        Node*	left	= idx > 0 ? parent->children[idx - 1] : nullptr;
+        Node*	right	= idx < parent->count ? parent->children[idx + 1] : nullptr;
+
+        if( child->leaf ) {
+            Leaf*	c	= static_cast<Leaf*>(child);
+            Leaf*	l	= static_cast<Leaf*>(left);
+            Leaf*	r	= static_cast<Leaf*>(right);
+            if( l && l->count > LEAF_MIN ) {
+                for( size_t j = c->count; j > 0; --j ) {
+                    c->keys[j]	= move(c->keys[j - 1]);
+                    c->values[j]	= move(c->values[j - 1]);
+                }
+                --l->count;
+                c->keys[0]	= move(l->keys[l->count]);
+                c->values[0]	= move(l->values[l->count]);
+                clearSlot(l, l->count);
+                ++c->count;
+                parent->keys[idx - 1]	= c->keys[0];
+            } else if( r && r->count > LEAF_MIN ) {
+                c->keys[c->count]	= move(r->keys[0]);
+                c->values[c->count]	= move(r->values[0]);
+                ++c->count;
+                for( size_t j = 1; j < r->count; ++j ) {
+                    r->keys[j - 1]		= move(r->keys[j]);
+                    r->values[j - 1]	= move(r->values[j]);
+                }
+                --r->count;
+                clearSlot(r, r->count);
+                parent->keys[idx]	= r->keys[0];
+            } else if( l ) {
+                mergeLeaves(l, c);
+                removeChild(parent, idx - 1);
+            } else {
+                mergeLeaves(c, r);
+                removeChild(parent, idx);
+            }
+            return;
+        }
+
+        Inner*	c	= static_cast<Inner*>(child);
+        Inner*	l	= static_cast<Inner*>(left);
+        Inner*	r	= static_cast<Inner*>(right);
+        if( l && l->count > INNER_MIN ) {
+            // rotate right through the parent separator
+            for( size_t j = c->count; j > 0; --j )
+                c->keys[j]	= move(c->keys[j - 1]);
+            for( size_t j = c->count + 1; j > 0; --j )
+                c->children[j]	= c->children[j - 1];
+            c->keys[0]		= move(parent->keys[idx - 1]);
+            c->children[0]		= l->children[l->count];
+            parent->keys[idx - 1]	= move(l->keys[l->count - 1]);
+            --l->count;
+            l->keys[l->count]	= K();
+            ++c->count;
+        } else if( r && r->count > INNER_MIN ) {
+            // rotate left
+            c->keys[c->count]		= move(parent->keys[idx]);
+            c->children[c->count + 1]	= r->children[0];
+            ++c->count;
+            parent->keys[idx]	= move(r->keys[0]);
+            for( size_t j = 1; j < r->count; ++j )
+                r->keys[j - 1]	= move(r->keys[j]);
+            for( size_t j = 1; j <= r->count; ++j )
+                r->children[j - 1]	= r->children[j];
+            --r->count;
+            r->keys[r->count]	= K();
+        } else if( l ) {
+            mergeInner(l, parent->keys[idx - 1], c);
+            removeChild(parent, idx - 1);
+        } else {
+            mergeInner(c, parent->keys[idx], r);
+            removeChild(parent, idx);
+        }
+    }
+
+    ///
+    /// append r to l and free r
+    ///
+    void
+    mergeLeaves(Leaf* l, Leaf* r) {
+        for( size_t j = 0; j < r->count; ++j ) {
+            l->keys[l->count + j]	= move(r->keys[j]);
+            l->values[l->count + j]	= move(r->values[j]);
+        }
+        l->count	+= r->count;
+        l->next		= r->next;
+        if( r->next )
+            r->next->prev	= l;
+        else
+            tail	= l;
+        delete r;
+    }
+
+    void
+    mergeInner(Inner* l, K& separator, Inner* r) {
+        l->keys[l->count]	= move(separator);
+        for( size_t j = 0; j < r->count; ++j )
+            l->keys[l->count + 1 + j]	= move(r->keys[j]);
+        for( size_t j = 0; j <= r->count; ++j )
+            l->children[l->count + 1 + j]	= r->children[j];
+        l->count	+= r->count + 1;
+        delete r;
+    }
+
+    ///
+    /// drop keys[k] and children[k + 1], after children[k + 1] was merged into children[k]
+    ///
+    static void
+    removeChild(Inner* in, size_t k) {
+        for( size_t j = k + 1; j < in->count; ++j )
+            in->keys[j - 1]	= move(in->keys[j]);
+        for( size_t j = k + 2; j <= in->count; ++j )
+            in->children[j - 1]	= in->children[j];
+        --in->count;
+        in->keys[in->count]	= K();
+    }
+
+    ///
+    /// slots past count hold default constructed entries, so whatever a vacated slot
+    /// still owns, moved from or not, is dropped now rather than when the node dies
+    ///
+    static void
+    clearSlot(Leaf* l, size_t i) {
+        l->keys[i]	= K();
+        l->values[i]	= V();
+    }
+
+    Node*	root;
+    Leaf*	head;
+    Leaf*	tail;
+    size_t	size;
+    Cmp	less;
+};
+
+}	// namespace BmCpp
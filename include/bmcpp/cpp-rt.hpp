@@ -22,11 +22,20 @@ inline void* operator new(size_t, void* p) noexcept { return p; }
 
 namespace BmCpp {
 
+enum
+{
+    CACHE_LINE_SIZE	= 64	///< padding unit keeping data written by different threads apart
+};
+
 struct BaseAllocation {
     inline void*    operator new(size_t len) noexcept { return malloc(len); }
     inline void*    operator new[](size_t len) noexcept { return malloc(len); }
     inline void     operator delete(void* p) noexcept { return free(p); }
     inline void     operator delete[](void* p) noexcept { return free(p); }
+
+    // the class specific operator new hides the global placement form
+    inline void*    operator new(size_t, void* p) noexcept { return p; }
+    inline void     operator delete(void*, void*) noexcept {}
 };
 
 class NonCopyable {
@@ -81,6 +90,27 @@ typename _RemoveReference<T>::_type&& move(T&& arg)
     return static_cast<typename _RemoveReference<T>::_type&&>(arg);
 }
 
+template <typename T>
+T&& forward(typename _RemoveReference<T>::_type& arg)
+{
+    return static_cast<T&&>(arg);
+}
+
+template<class _Ty>
+struct _RemoveConst
+{   // remove top level const
+    typedef _Ty _type;
+};
+
+template<class _Ty>
+struct _RemoveConst<const _Ty>
+{
+    typedef _Ty _type;
+};
+
+template<class A, class B> struct IsSame { enum { value = 0 }; };
+template<class A> struct IsSame<A, A> { enum { value = 1 }; };
+
 template<bool Cond, class T = void> struct EnableIf {};
 template<class T> struct EnableIf<true, T> { typedef T type; };
 
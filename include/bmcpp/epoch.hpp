@@ -0,0 +1,319 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "array.hpp"
+#include "object.hpp"
+
+#include <sched.h>
+
+namespace BmCpp {
+
+///
+/// epoch based reclamation for Objects read concurrently without touching their count.
+///
+/// readers pin the current global epoch for the duration of an EpochGuard and read
+/// shared raw pointers freely. a writer that unlinks an object hands its reference to
+/// retire() instead of releasing it. the global epoch only advances once every pinned
+/// participant has seen the current one, so an object retired in epoch e cannot be
+/// reachable by any reader once the epoch is e + 2, and its reference is dropped then.
+///
+/// threads use the domain through a Participant slot claimed with attach(). retired
+/// objects are kept per participant in three bags, one per live epoch
+///
+struct EpochDomain : public BaseAllocation, private NonCopyable
+{
+    enum
+    {
+        DEFAULT_MAX_PARTICIPANTS	= 64,
+        COLLECT_THRESHOLD		= 64	///< retirements between two reclamation attempts
+    };
+
+    struct Participant : private NonCopyable
+    {
+        Participant() : epoch(0), used(false), nesting(0), pending(0) {
+            for( size_t i = 0; i < 3; ++i )
+                bagEpoch[i]	= 0;
+        }
+
+    private:
+        std::atomic<uint64_t>	epoch;		///< pinned epoch << 1 | 1 while inside a guard, 0 otherwise
+        std::atomic<bool>	used;
+        size_t			nesting;
+        size_t			pending;	///< retirements since the last collection
+        uint64_t		bagEpoch[3];
+        Array<const Object*>	bags[3];
+        char			pad[CACHE_LINE_SIZE];
+
+        friend struct EpochDomain;
+    };
+
+    explicit EpochDomain(size_t maxParticipants = DEFAULT_MAX_PARTICIPANTS)
+        : globalEpoch(1), participantCount(maxParticipants) {
+        // readers hold Participant pointers, so the slots are laid out once and never move
+        participants	= static_cast<Participant*>(malloc(participantCount * sizeof(Participant)));
+        assert(participants != nullptr || participantCount == 0);
+        for( size_t i = 0; i < participantCount; ++i )
+            new(&participants[i]) Participant();
+    }
+
+    ~EpochDomain() {
+        for( size_t i = 0; i < participantCount; ++i ) {
+            assert(participants[i].nesting == 0 && "EpochDomain destroyed while pinned");
+            for( size_t b = 0; b < 3; ++b )
+                releaseBag(participants[i], b);
+            participants[i].~Participant();
+        }
+        free(participants);
+    }
+
+    ///
+    /// claim a participant slot for the calling thread
+    /// @return the slot or nullptr if all of them are taken
+    ///
+    Participant*
+    attach() {
+        for( size_t i = 0; i < participantCount; ++i ) {
+            bool	expected	= false;
+            Participant&	p	= participants[i];
+            if( !p.used.load(std::memory_order_relaxed)
+                && p.used.compare_exchange_strong(expected, true, std::memory_order_acquire) )
+                return &p;
+        }
+        return nullptr;
+    }
+
+    ///
+    /// give the slot back. objects it still holds stay in it until a later owner or
+    /// the domain reclaims them
+    ///
+    void
+    detach(Participant* p) {
+        assert(p->nesting == 0);
+        collect(p);
+        p->used.store(false, std::memory_order_release);
+    }
+
+    ///
+    /// start a read side critical section, nestable
+    ///
+    void
+    enter(Participant* p) {
+        if( p->nesting++ == 0 ) {
+            uint64_t	e	= globalEpoch.load(std::memory_order_relaxed);
+            for(;;) {
+                // a full barrier: the pin is visible before any shared pointer is read
+                p->epoch.exchange((e << 1) | 1, std::memory_order_seq_cst);
+                uint64_t	now	= globalEpoch.load(std::memory_order_relaxed);
+                if( now == e )
+                    break;
+                e	= now;	// the epoch moved while we were publishing, pin the new one
+            }
+        }
+    }
+
+    void
+    leave(Participant* p) {
+        assert(p->nesting > 0);
+        if( --p->nesting == 0 )
+            p->epoch.store(0, std::memory_order_release);
+    }
+
+    ///
+    /// deferred release: obj must already be unreachable for new readers, its
+    /// reference is dropped once no reader can still hold it
+    /// @param p the calling thread's participant
+    /// @param obj the object, the caller gives up one reference
+    ///
+    void
+    retire(Participant* p, const Object* obj) {
+        std::atomic_thread_fence(std::memory_order_seq_cst);	// the unlink happens before the epoch read
+        uint64_t	e	= globalEpoch.load(std::memory_order_relaxed);
+        size_t		b	= size_t(e % 3);
+        if( p->bagEpoch[b] != e ) {
+            // the bag is from epoch e - 3 or older, long past its grace period
+            releaseBag(*p, b);
+            p->bagEpoch[b]	= e;
+        }
+        p->bags[b].pushBack(obj);
+
+        if( ++p->pending >= COLLECT_THRESHOLD )
+            collect(p);
+    }
+
+    template<typename T>
+    void
+    retire(Participant* p, ObjectPtr<T>&& obj) {
+        if( T* o = obj.detach() )
+            retire(p, o);
+    }
+
+    ///
+    /// try to advance the epoch and drop every reference of p whose grace period is over
+    ///
+    void
+    collect(Participant* p) {
+        p->pending	= 0;
+        tryAdvance();
+        uint64_t	e	= globalEpoch.load(std::memory_order_acquire);
+        for( size_t b = 0; b < 3; ++b )
+            if( p->bagEpoch[b] + 2 <= e )
+                releaseBag(*p, b);
+    }
+
+    ///
+    /// block until everything p has retired so far is released. must not be called
+    /// while p is inside a guard
+    ///
+    void
+    synchronize(Participant* p) {
+        assert(p->nesting == 0);
+        for(;;) {
+            collect(p);
+            if( p->bags[0].size() == 0 && p->bags[1].size() == 0 && p->bags[2].size() == 0 )
+                return;
+            sched_yield();
+        }
+    }
+
+    ///
+    /// advance the global epoch if every pinned participant has observed it
+    /// @return false if a reader still holds an older epoch
+    ///
+    bool
+    tryAdvance() {
+        uint64_t	e	= globalEpoch.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        for( size_t i = 0; i < participantCount; ++i ) {
+            uint64_t	v	= participants[i].epoch.load(std::memory_order_acquire);
+            if( (v & 1) && (v >> 1) != e )
+                return false;
+        }
+        // losing the race means another thread advanced it for us
+        globalEpoch.compare_exchange_strong(e, e + 1, std::memory_order_acq_rel);
+        return true;
+    }
+
+    uint64_t	epoch() const	{ return globalEpoch.load(std::memory_order_relaxed);	}
+
+private:
+    void
+    releaseBag(Participant& p, size_t b) {
+        Array<const Object*>&	bag	= p.bags[b];
+        for( size_t i = 0; i < bag.size(); ++i )
+            bag[i]->release();
+        bag.clear();
+    }
+
+    std::atomic<uint64_t>	globalEpoch;
+    char			pad0[CACHE_LINE_SIZE - sizeof(std::atomic<uint64_t>)];
+    Participant*		participants;
+    size_t			participantCount;
+};	// struct EpochDomain
+
+///
+/// scoped read side critical section
+///
+struct EpochGuard : private NonCopyable
+{
+    EpochGuard(EpochDomain& domain, EpochDomain::Participant* p) : domain(domain), p(p) {
+        domain.enter(p);
+    }
+
+    ~EpochGuard() {
+        domain.leave(p);
+    }
+
+private:
+    EpochDomain&		domain;
+    EpochDomain::Participant*	p;
+};	// struct EpochGuard
+
+///
+/// atomically replaceable ObjectPtr for publishing immutable snapshots (RCU style).
+/// the pointer owns one reference on its target; replaced targets are retired through
+/// the epoch domain, so readers inside an EpochGuard can use read() without touching
+/// the count, and load() can safely grab a reference to a target being replaced.
+/// every call takes the calling thread's participant of that domain
+///
+template<typename T>
+struct AtomicObjectPtr : public BaseAllocation, private NonCopyable
+{
+    explicit AtomicObjectPtr(EpochDomain& domain, ObjectPtr<T> init = ObjectPtr<T>())
+        : domain(domain), ptr(init.detach()) {
+    }
+
+    /// no reader may still be using the pointer
+    ~AtomicObjectPtr() {
+        if( T* t = ptr.load(std::memory_order_relaxed) )
+            t->release();
+    }
+
+    ///
+    /// the current target, valid until the guard is left. wait-free, no count traffic
+    ///
+    T*
+    read(const EpochGuard& /*guard*/) const {
+        return ptr.load(std::memory_order_acquire);
+    }
+
+    ///
+    /// @return a strong reference to the current target
+    ///
+    ObjectPtr<T>
+    load(EpochDomain::Participant* p) const {
+        EpochGuard	guard(domain, p);
+        T*	t	= ptr.load(std::memory_order_acquire);
+        if( t )
+            t->grab();
+        return ObjectPtr<T>::adopt(t);
+    }
+
+    void
+    store(EpochDomain::Participant* p, ObjectPtr<T> desired) {
+        if( T* old = ptr.exchange(desired.detach(), std::memory_order_acq_rel) )
+            domain.retire(p, old);
+    }
+
+    ///
+    /// @return a strong reference to the previous target
+    ///
+    ObjectPtr<T>
+    exchange(EpochDomain::Participant* p, ObjectPtr<T> desired) {
+        T*	old	= ptr.exchange(desired.detach(), std::memory_order_acq_rel);
+        if( old ) {
+            // readers may still be looking at old, so the caller gets a fresh reference
+            // and the one the pointer held goes through the domain
+            old->grab();
+            domain.retire(p, old);
+        }
+        return ObjectPtr<T>::adopt(old);
+    }
+
+    ///
+    /// replace the target with desired if it is still expected
+    /// @param expected on failure, receives the current target
+    /// @return true if the pointer was replaced
+    ///
+    bool
+    compareExchange(EpochDomain::Participant* p, ObjectPtr<T>& expected, ObjectPtr<T> desired) {
+        EpochGuard	guard(domain, p);
+        T*	cur	= expected.get();
+        if( ptr.compare_exchange_strong(cur, desired.get(), std::memory_order_acq_rel) ) {
+            desired.detach();
+            if( cur )
+                domain.retire(p, cur);
+            return true;
+        }
+
+        if( cur )
+            cur->grab();	// pinned, so cur is still alive
+        expected	= ObjectPtr<T>::adopt(cur);
+        return false;
+    }
+
+private:
+    EpochDomain&		domain;
+    std::atomic<T*>		ptr;
+};	// struct AtomicObjectPtr
+
+}	// namespace BmCpp
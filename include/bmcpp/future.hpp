@@ -0,0 +1,436 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "array.hpp"
+#include "lambda.hpp"
+#include "object.hpp"
+#include "threadpool.hpp"
+
+#include <atomic>
+#include <pthread.h>
+
+namespace BmCpp {
+
+///
+/// error codes used by the futures themselves, anything else is up to the user.
+/// 0 always means success
+///
+enum FutureError
+{
+    FUTURE_OK		= 0,
+    BROKEN_PROMISE	= -1	///< the promise went away without a value or an error
+};
+
+///
+/// either a value or a non zero error code. errors travel as values since we have no
+/// exceptions; a default constructed Result holds BROKEN_PROMISE
+///
+template<typename T>
+struct Result : public BaseAllocation
+{
+    Result() : code(BROKEN_PROMISE)			{}
+    Result(const T& v) : code(FUTURE_OK)		{ new(&val) T(v);	}
+    Result(T&& v) : code(FUTURE_OK)			{ new(&val) T(move(v));	}
+    Result(const Result& r) : code(r.code)		{ if( r.ok() ) new(&val) T(r.val);	}
+    Result(Result&& r) : code(r.code)			{ if( r.ok() ) new(&val) T(move(r.val));	}
+    ~Result()						{ if( ok() ) val.~T();	}
+
+    Result&
+    operator = (const Result& r) {
+        if( this != &r ) {
+            this->~Result();
+            code	= r.code;
+            if( ok() )
+                new(&val) T(r.val);
+        }
+        return *this;
+    }
+
+    Result&
+    operator = (Result&& r) {
+        if( this != &r ) {
+            this->~Result();
+            code	= r.code;
+            if( ok() )
+                new(&val) T(move(r.val));
+        }
+        return *this;
+    }
+
+    static Result
+    failure(int code) {
+        assert(code != FUTURE_OK);
+        Result	r;
+        r.code	= code;
+        return r;
+    }
+
+    bool		ok() const	{ return code == FUTURE_OK;	}
+    int			error() const	{ return code;	}
+    T&			value()		{ assert(ok()); return val;	}
+    const T&		value() const	{ assert(ok()); return val;	}
+
+private:
+    union {
+        T	val;
+    };
+    int		code;
+};
+
+///
+/// value of a Future<Unit>, what then() produces for continuations returning void
+///
+struct Unit {};
+
+///
+/// where continuations run. then() without an executor runs the continuation on the
+/// thread that fulfils the promise (or on the caller when the future is already ready)
+///
+struct Executor : public BaseAllocation
+{
+    virtual ~Executor()	{}
+    virtual void	execute(Lambda<void()>&& fn) = 0;
+};
+
+struct PoolExecutor : public Executor
+{
+    explicit PoolExecutor(ThreadPool& pool) : pool(pool)	{}
+    void	execute(Lambda<void()>&& fn) override	{ pool.submit(move(fn)); }
+
+    ThreadPool&	pool;
+};
+
+template<typename T> struct Future;
+template<typename T> struct Promise;
+
+namespace Detail {
+
+template<typename T> T&& declVal();
+
+///
+/// shared by a Promise and its Futures. the lock only guards the hand over between
+/// registering continuations and completing; once done is set the result is immutable
+///
+template<typename T>
+struct FutureState : public Object
+{
+    FutureState() : done(false), waiters(0) {
+        pthread_mutex_init(&lock, nullptr);
+        pthread_cond_init(&cond, nullptr);
+    }
+
+    ~FutureState() {
+        pthread_cond_destroy(&cond);
+        pthread_mutex_destroy(&lock);
+    }
+
+    void
+    complete(Result<T>&& r) {
+        pthread_mutex_lock(&lock);
+        assert(!isDone());
+        result	= move(r);
+        done.store(true, std::memory_order_release);
+        Lambda<void()>		fn(move(first));
+        Array<Lambda<void()>>	rest(move(more));
+        if( waiters )
+            pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&lock);
+
+        if( fn )
+            fn();
+        for( size_t i = 0; i < rest.size(); ++i )
+            rest[i]();
+    }
+
+    void
+    onComplete(Lambda<void()>&& fn) {
+        pthread_mutex_lock(&lock);
+        if( !isDone() ) {
+            // most futures get a single continuation, keep it out of the array
+            if( !first )
+                first	= move(fn);
+            else
+                more.pushBack(move(fn));
+            pthread_mutex_unlock(&lock);
+            return;
+        }
+        pthread_mutex_unlock(&lock);
+        fn();
+    }
+
+    bool	isDone() const	{ return done.load(std::memory_order_acquire);	}
+
+    void
+    wait() {
+        if( isDone() )
+            return;
+        pthread_mutex_lock(&lock);
+        ++waiters;
+        while( !isDone() )
+            pthread_cond_wait(&cond, &lock);
+        --waiters;
+        pthread_mutex_unlock(&lock);
+    }
+
+    pthread_mutex_t		lock;
+    pthread_cond_t		cond;
+    std::atomic<bool>		done;
+    int				waiters;
+    Result<T>			result;
+    Lambda<void()>		first;
+    Array<Lambda<void()>>	more;
+};
+
+///
+/// maps what a continuation returns to the value of the future then() hands back:
+/// R gives Future<R>, Result<R> gives Future<R> (errors pass through), void gives
+/// Future<Unit>
+///
+template<typename R>
+struct ThenTraits
+{
+    typedef R	Value;
+
+    template<typename P, typename Fn, typename A>
+    static void	fulfil(P& p, Fn& fn, const A& a)	{ p.setValue(fn(a)); }
+};
+
+template<typename R>
+struct ThenTraits<Result<R>>
+{
+    typedef R	Value;
+
+    template<typename P, typename Fn, typename A>
+    static void	fulfil(P& p, Fn& fn, const A& a)	{ p.setResult(fn(a)); }
+};
+
+template<>
+struct ThenTraits<void>
+{
+    typedef Unit	Value;
+
+    template<typename P, typename Fn, typename A>
+    static void	fulfil(P& p, Fn& fn, const A& a)	{ fn(a); p.setValue(Unit()); }
+};
+
+template<typename T, typename Fn>
+struct Continuation
+{
+    typedef decltype(declVal<Fn&>()(declVal<const Result<T>&>()))	Return;
+    typedef ThenTraits<Return>					Traits;
+    typedef typename Traits::Value					Value;
+
+    Continuation(const ObjectPtr<FutureState<T>>& source, Fn&& fn) : source(source), fn(move(fn))	{}
+
+    void	operator()()	{ Traits::fulfil(promise, fn, source->result); }
+
+    ObjectPtr<FutureState<T>>	source;
+    Fn				fn;
+    Promise<Value>		promise;
+};
+
+template<typename C>
+struct Dispatch
+{
+    Dispatch(Executor* executor, C&& c) : executor(executor), c(move(c))	{}
+
+    void	operator()()	{ executor->execute(Lambda<void()>(move(c))); }
+
+    Executor*	executor;
+    C		c;
+};
+
+}	// namespace Detail
+
+///
+/// read side of an asynchronous value, a reference counted handle to the state shared
+/// with the Promise. copies see the same result
+///
+template<typename T>
+struct Future : public BaseAllocation
+{
+    Future()	{}
+
+    bool	valid() const	{ return state.get() != nullptr;	}
+    bool	isReady() const	{ return state->isDone();	}
+
+    ///
+    /// block the calling thread until the promise is fulfilled
+    ///
+    void	wait() const	{ state->wait();	}
+
+    ///
+    /// @return the result, after waiting for it
+    ///
+    const Result<T>&
+    get() const {
+        state->wait();
+        return state->result;
+    }
+
+    ///
+    /// run fn(const Result<T>&) once this future is ready, without blocking
+    /// @return a future for what fn returns (see Detail::ThenTraits)
+    ///
+    template<typename Fn>
+    Future<typename Detail::Continuation<T, typename _RemoveReference<Fn>::_type>::Value>
+    then(Fn&& fn) const {
+        typedef Detail::Continuation<T, typename _RemoveReference<Fn>::_type>	C;
+        C	c(state, typename _RemoveReference<Fn>::_type(forward<Fn>(fn)));
+        Future<typename C::Value>	f	= c.promise.future();
+        state->onComplete(Lambda<void()>(move(c)));
+        return f;
+    }
+
+    ///
+    /// same as then(fn) but fn is handed to executor once this future is ready
+    ///
+    template<typename Fn>
+    Future<typename Detail::Continuation<T, typename _RemoveReference<Fn>::_type>::Value>
+    then(Executor& executor, Fn&& fn) const {
+        typedef Detail::Continuation<T, typename _RemoveReference<Fn>::_type>	C;
+        C	c(state, typename _RemoveReference<Fn>::_type(forward<Fn>(fn)));
+        Future<typename C::Value>	f	= c.promise.future();
+        state->onComplete(Lambda<void()>(Detail::Dispatch<C>(&executor, move(c))));
+        return f;
+    }
+
+private:
+    explicit Future(const ObjectPtr<Detail::FutureState<T>>& state) : state(state)	{}
+
+    template<typename U> friend struct Promise;
+    template<typename U> friend Future<Array<Result<U>>> whenAll(const Array<Future<U>>& futures);
+    template<typename U> friend Future<size_t> whenAny(const Array<Future<U>>& futures);
+
+    ObjectPtr<Detail::FutureState<T>>	state;
+};
+
+///
+/// write side: set a value or an error exactly once. a promise destroyed before that
+/// completes its future with BROKEN_PROMISE, so continuations always run
+///
+template<typename T>
+struct Promise : public BaseAllocation
+{
+    Promise() : state(new Detail::FutureState<T>())	{}
+    Promise(Promise&& p) : state(move(p.state))	{}
+    ~Promise()					{ abandon();	}
+
+    Promise&
+    operator = (Promise&& p) {
+        abandon();
+        state	= move(p.state);
+        return *this;
+    }
+
+    ///
+    /// @return a future on this promise, only before it is fulfilled
+    ///
+    Future<T>	future() const	{ assert(state); return Future<T>(state);	}
+
+    void	setValue(const T& v)		{ setResult(Result<T>(v));	}
+    void	setValue(T&& v)			{ setResult(Result<T>(move(v)));	}
+    void	setError(int code)		{ setResult(Result<T>::failure(code));	}
+
+    void
+    setResult(Result<T>&& r) {
+        assert(state);	// already fulfilled
+        ObjectPtr<Detail::FutureState<T>>	s(move(state));
+        s->complete(move(r));
+    }
+
+private:
+    Promise(const Promise&);
+    Promise& operator = (const Promise&);
+
+    void
+    abandon() {
+        if( state )
+            setResult(Result<T>());
+    }
+
+    ObjectPtr<Detail::FutureState<T>>	state;
+};
+
+template<typename T>
+Future<typename _RemoveConst<typename _RemoveReference<T>::_type>::_type>
+makeReadyFuture(T&& v) {
+    Promise<typename _RemoveConst<typename _RemoveReference<T>::_type>::_type>	p;
+    Future<typename _RemoveConst<typename _RemoveReference<T>::_type>::_type>	f	= p.future();
+    p.setValue(forward<T>(v));
+    return f;
+}
+
+template<typename T>
+Future<T>
+makeErrorFuture(int code) {
+    Promise<T>	p;
+    Future<T>	f	= p.future();
+    p.setError(code);
+    return f;
+}
+
+///
+/// @return a future holding every input's result, in order, once all are ready
+///
+template<typename T>
+Future<Array<Result<T>>>
+whenAll(const Array<Future<T>>& futures) {
+    struct All : public Object
+    {
+        explicit All(size_t n) : remaining(n)	{ results.resize(n); }
+
+        std::atomic<size_t>		remaining;
+        Array<Result<T>>		results;
+        Promise<Array<Result<T>>>	promise;
+    };
+
+    ObjectPtr<All>			all(new All(futures.size()));
+    Future<Array<Result<T>>>	f	= all->promise.future();
+    if( futures.size() == 0 ) {
+        all->promise.setValue(Array<Result<T>>());
+        return f;
+    }
+
+    for( size_t i = 0; i < futures.size(); ++i ) {
+        ObjectPtr<Detail::FutureState<T>>	src	= futures[i].state;
+        src->onComplete([all, src, i]() {
+            all->results[i]	= src->result;
+            // the last one in publishes: acq_rel orders every other slot write before it
+            if( all->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1 )
+                all->promise.setValue(move(all->results));
+        });
+    }
+    return f;
+}
+
+///
+/// @return a future holding the index of the first input to become ready
+/// (BROKEN_PROMISE for an empty array)
+///
+template<typename T>
+Future<size_t>
+whenAny(const Array<Future<T>>& futures) {
+    struct Any : public Object
+    {
+        Any() : fired(false)	{}
+
+        std::atomic<bool>	fired;
+        Promise<size_t>		promise;
+    };
+
+    if( futures.size() == 0 )
+        return makeErrorFuture<size_t>(BROKEN_PROMISE);
+
+    ObjectPtr<Any>	any(new Any());
+    Future<size_t>	f	= any->promise.future();
+    for( size_t i = 0; i < futures.size(); ++i ) {
+        futures[i].state->onComplete([any, i]() {
+            if( !any->fired.exchange(true, std::memory_order_acq_rel) )
+                any->promise.setValue(i);
+        });
+    }
+    return f;
+}
+
+}	// namespace BmCpp
@@ -8,6 +8,7 @@
  */
 
 #include "array.hpp"
+#include "lambda.hpp"
 
 namespace BmCpp {
 
@@ -71,12 +72,12 @@ public:
         uint32_t hash = Hash(key);
         int index = hash & (fCapacity-1);
         for (int n = 0; n < fCapacity; n++) {
-            Slot& s = fSlots[index];
+            const Slot& s = fSlots[index];
             if (s.empty()) {
                 return nullptr;
             }
             if (hash == s.hash && key == Traits::GetKey(s.val)) {
-                return &s.val;
+                return const_cast<T*>(&s.val);
             }
             index = this->next(index);
         }
@@ -130,19 +131,26 @@ public:
     }
 
     // Call fn on every entry in the table.  You may mutate the entries, but be very careful.
-    template <typename Fn>  // f(T*)
-    void foreach(Fn&& fn) {
-        for (int i = 0; i < fCapacity; i++) {
+    void foreach(FunctionRef<void(T*)> fn) { this->foreach(0, fCapacity, fn); }
+
+    // Call fn on every entry in the table.  You may not mutate anything.
+    void foreach(FunctionRef<void(const T&)> fn) const { this->foreach(0, fCapacity, fn); }
+
+    // How many slots the table has; [0, capacity()) can be split for foreach(begin, end, fn).
+    int capacity() const { return fCapacity; }
+
+    // Call fn on every entry stored in slots [begin, end).  Disjoint ranges may be walked
+    // concurrently.
+    void foreach(int begin, int end, FunctionRef<void(T*)> fn) {
+        for (int i = begin; i < end; i++) {
             if (!fSlots[i].empty()) {
                 fn(&fSlots[i].val);
             }
         }
     }
 
-    // Call fn on every entry in the table.  You may not mutate anything.
-    template <typename Fn>  // f(T) or f(const T&)
-    void foreach(Fn&& fn) const {
-        for (int i = 0; i < fCapacity; i++) {
+    void foreach(int begin, int end, FunctionRef<void(const T&)> fn) const {
+        for (int i = begin; i < end; i++) {
             if (!fSlots[i].empty()) {
                 fn(fSlots[i].val);
             }
@@ -183,7 +191,8 @@ private:
         fCount = 0;
         fCapacity = capacity;
         Array<Slot> oldSlots = move(fSlots);
-        fSlots = Array<Slot>(capacity);
+        fSlots = Array<Slot>();
+        fSlots.resize(capacity);
 
         for (int i = 0; i < oldCapacity; i++) {
             Slot& s = oldSlots[i];
@@ -271,17 +280,29 @@ public:
     }
 
     // Call fn on every key/value pair in the table.  You may mutate the value but not the key.
-    template <typename Fn>  // f(K, V*) or f(const K&, V*)
-    void foreach(Fn&& fn) {
+    void foreach(FunctionRef<void(const K&, V*)> fn) {  // f(K, V*) or f(const K&, V*)
         fTable.foreach([&fn](Pair* p){ fn(p->key, &p->val); });
     }
 
     // Call fn on every key/value pair in the table.  You may not mutate anything.
-    template <typename Fn>  // f(K, V), f(const K&, V), f(K, const V&) or f(const K&, const V&).
-    void foreach(Fn&& fn) const {
+    // f(K, V), f(const K&, V), f(K, const V&) or f(const K&, const V&).
+    void foreach(FunctionRef<void(const K&, const V&)> fn) const {
         fTable.foreach([&fn](const Pair& p){ fn(p.key, p.val); });
     }
 
+    // How many slots the table has; [0, capacity()) can be split for foreach(begin, end, fn).
+    int capacity() const { return fTable.capacity(); }
+
+    // Call fn on the pairs stored in slots [begin, end).  Disjoint ranges may be walked
+    // concurrently.
+    void foreach(int begin, int end, FunctionRef<void(const K&, V*)> fn) {
+        fTable.foreach(begin, end, [&fn](Pair* p){ fn(p->key, &p->val); });
+    }
+
+    void foreach(int begin, int end, FunctionRef<void(const K&, const V&)> fn) const {
+        fTable.foreach(begin, end, [&fn](const Pair& p){ fn(p.key, p.val); });
+    }
+
 private:
     struct Pair {
         K key;
@@ -330,11 +351,17 @@ public:
     }
 
     // Call fn on every item in the set.  You may not mutate anything.
-    template <typename Fn>  // f(T), f(const T&)
-    void foreach (Fn&& fn) const {
+    void foreach (FunctionRef<void(const T&)> fn) const {  // f(T), f(const T&)
         fTable.foreach(fn);
     }
 
+    // How many slots the table has; [0, capacity()) can be split for foreach(begin, end, fn).
+    int capacity() const { return fTable.capacity(); }
+
+    void foreach (int begin, int end, FunctionRef<void(const T&)> fn) const {
+        fTable.foreach(begin, end, fn);
+    }
+
 private:
     struct Traits {
         static const T& GetKey(const T& item) { return item; }
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "array.hpp"
+
+#include <cstdint>
+
+namespace BmCpp {
+
+///
+/// priority queue on a 4-ary heap in an Array: top() is the element no other element
+/// is less than. four children sit next to each other, so a sift down compares a whole
+/// cache line of siblings per level and the tree is half as deep as a binary heap.
+///
+/// push() returns a Handle that keeps naming the element while it moves around the
+/// heap, for update()/decreaseKey()/erase() in O(log n). handles of popped or erased
+/// elements are recycled
+///
+template<typename T, typename Cmp = Less<T>>
+struct PriorityQueue : public BaseAllocation, private NonCopyable
+{
+    typedef uint32_t	Handle;
+
+    enum
+    {
+        ARITY		= 4,
+        INVALID		= 0xffffffffu	///< position of a free handle
+    };
+
+    PriorityQueue()	{}
+    explicit PriorityQueue(const Cmp& less) : less(less)	{}
+
+    size_t	size() const	{ return heap.size();	}
+    bool	empty() const	{ return heap.size() == 0;	}
+
+    void
+    reserve(size_t n) {
+        heap.reserve(n);
+        positions.reserve(n);
+    }
+
+    void
+    clear() {
+        heap.clear();
+        positions.clear();
+        freeHandles.clear();
+    }
+
+    Handle	push(const T& t)	{ return insert(T(t));	}
+    Handle	push(T&& t)		{ return insert(move(t));	}
+
+    const T&	top() const		{ assert(!empty()); return heap[0].value;	}
+    Handle		topHandle() const	{ assert(!empty()); return heap[0].handle;	}
+
+    void	pop()	{ assert(!empty()); erase(heap[0].handle);	}
+
+    ///
+    /// move the top element out and remove it
+    ///
+    T
+    take() {
+        assert(!empty());
+        T	t(move(heap[0].value));
+        erase(heap[0].handle);
+        return t;
+    }
+
+    bool		contains(Handle h) const	{ return h < positions.size() && positions[h] != INVALID;	}
+    const T&	get(Handle h) const		{ assert(contains(h)); return heap[positions[h]].value;	}
+
+    ///
+    /// replace the element behind h and restore the heap order
+    ///
+    void
+    update(Handle h, T t) {
+        assert(contains(h));
+        uint32_t	i	= positions[h];
+        bool		up	= less(t, heap[i].value);
+        heap[i].value	= move(t);
+        if( up )
+            siftUp(i);
+        else
+            siftDown(i);
+    }
+
+    ///
+    /// update() for a value that is not greater than the current one
+    ///
+    void
+    decreaseKey(Handle h, T t) {
+        assert(contains(h) && !less(get(h), t));
+        uint32_t	i	= positions[h];
+        heap[i].value	= move(t);
+        siftUp(i);
+    }
+
+    void
+    erase(Handle h) {
+        assert(contains(h));
+        uint32_t	i	= positions[h];
+        uint32_t	last	= uint32_t(heap.size() - 1);
+        positions[h]	= INVALID;
+        freeHandles.pushBack(h);
+        if( i != last ) {
+            heap[i]	= move(heap[last]);
+            positions[heap[i].handle]	= i;
+            heap.popBack();
+            // the moved element may belong above or below its new slot
+            if( i > 0 && less(heap[i].value, heap[(i - 1) / ARITY].value) )
+                siftUp(i);
+            else
+                siftDown(i);
+        } else {
+            heap.popBack();
+        }
+    }
+
+private:
+    struct Entry
+    {
+        Entry(T&& value, Handle handle) : value(move(value)), handle(handle)	{}
+
+        T	value;
+        Handle	handle;
+    };
+
+    Handle
+    insert(T&& t) {
+        Handle	h;
+        if( freeHandles.size() ) {
+            h	= freeHandles[freeHandles.size() - 1];
+            freeHandles.popBack();
+        } else {
+            h	= Handle(positions.size());
+            positions.pushBack(INVALID);
+        }
+        uint32_t	i	= uint32_t(heap.size());
+        heap.pushBack(Entry(move(t), h));
+        positions[h]	= i;
+        siftUp(i);
+        return h;
+    }
+
+    ///
+    /// hole based sifts: the moving entry is held aside and written once at the end
+    ///
+    void
+    siftUp(uint32_t i) {
+        Entry	e(move(heap[i]));
+        while( i > 0 ) {
+            uint32_t	parent	= (i - 1) / ARITY;
+            if( !less(e.value, heap[parent].value) )
+                break;
+            heap[i]	= move(heap[parent]);
+            positions[heap[i].handle]	= i;
+            i	= parent;
+        }
+        heap[i]	= move(e);
+        positions[heap[i].handle]	= i;
+    }
+
+    void
+    siftDown(uint32_t i) {
+        uint32_t	n	= uint32_t(heap.size());
+        Entry		e(move(heap[i]));
+        for(;;) {
+            uint32_t	first	= i * ARITY + 1;
+            if( first >= n )
+                break;
+            uint32_t	end	= first + ARITY < n ? first + ARITY : n;
+            uint32_t	best	= first;
+            for( uint32_t c = first + 1; c < end; ++c )
+                if( less(heap[c].value, heap[best].value) )
+                    best	= c;
+            if( !less(heap[best].value, e.value) )
+                break;
+            heap[i]	= move(heap[best]);
+            positions[heap[i].handle]	= i;
+            i	= best;
+        }
+        heap[i]	= move(e);
+        positions[heap[i].handle]	= i;
+    }
+
+    Array<Entry>	heap;
+    Array<uint32_t>	positions;	///< heap index by handle, INVALID when free
+    Array<Handle>	freeHandles;
+    Cmp		less;
+};
+
+}	// namespace BmCpp
@@ -1,56 +1,225 @@
 #ifndef LAMBDA_HPP
 #define LAMBDA_HPP
 
-#include "object.hpp"
+#include "cpp-rt.hpp"
+
+#include <cstddef>
 
 namespace BmCpp {
 template <typename T>
 class Lambda;
 
+///
+/// move-only type erased callable. closures up to INLINE_SIZE bytes live in the
+/// object itself, bigger ones are placed on the heap. a call is one indirect jump
+/// through invoke_, moving and destroying go through the per type manage_ function
+///
 template <typename ReturnValue, typename... Args>
 class Lambda<ReturnValue(Args...)> {
 public:
-    template <typename T>
-    Lambda(T t) : callable_(new CallableT<T>(t)) {
+    enum
+    {
+        INLINE_SIZE	= 48
+    };
+
+    Lambda() : invoke_(nullptr), manage_(nullptr) {
     }
 
-    template <typename T>
-    Lambda& operator=(T t) {
-        callable_ = new CallableT<T>(t);
+    template <typename T, typename = typename EnableIf<!IsSame<typename _RemoveConst<typename _RemoveReference<T>::_type>::_type, Lambda>::value>::type>
+    Lambda(T&& t) : invoke_(nullptr), manage_(nullptr) {
+        construct<typename _RemoveConst<typename _RemoveReference<T>::_type>::_type>(forward<T>(t));
+    }
+
+    Lambda(Lambda&& other) : invoke_(other.invoke_), manage_(other.manage_) {
+        if( manage_ )
+            manage_(MOVE, storage_, other.storage_);
+        other.invoke_	= nullptr;
+        other.manage_	= nullptr;
+    }
+
+    ~Lambda() {
+        reset();
+    }
+
+    Lambda& operator=(Lambda&& other) {
+        if( this != &other ) {
+            reset();
+            invoke_	= other.invoke_;
+            manage_	= other.manage_;
+            if( manage_ )
+                manage_(MOVE, storage_, other.storage_);
+            other.invoke_	= nullptr;
+            other.manage_	= nullptr;
+        }
+        return *this;
+    }
+
+    template <typename T, typename = typename EnableIf<!IsSame<typename _RemoveConst<typename _RemoveReference<T>::_type>::_type, Lambda>::value>::type>
+    Lambda& operator=(T&& t) {
+        reset();
+        construct<typename _RemoveConst<typename _RemoveReference<T>::_type>::_type>(forward<T>(t));
         return *this;
     }
 
     ReturnValue operator()(Args... args) const {
-        assert(callable_);
-        return callable_->Invoke(args...);
+        assert(invoke_);
+        return invoke_(storage_, forward<Args>(args)...);
+    }
+
+    explicit operator bool() const	{ return invoke_ != nullptr; }
+
+    void
+    reset() {
+        if( manage_ )
+            manage_(DESTROY, storage_, storage_);
+        invoke_	= nullptr;
+        manage_	= nullptr;
     }
 
 private:
-    class ICallable : public BmCpp::Object {
-    public:
-        MAKE_ALL_PTRS(ICallable);
-        virtual ~ICallable() = default;
-        virtual ReturnValue Invoke(Args...) = 0;
+    Lambda(const Lambda&);
+    Lambda& operator=(const Lambda&);
+
+    union Storage {
+        void*			heap;
+        std::max_align_t		align;
+        unsigned char		buffer[INLINE_SIZE];
+    };
+
+    enum Op { MOVE, DESTROY };
+
+    typedef ReturnValue	(*InvokeFn)(Storage&, Args&&...);
+    typedef void		(*ManageFn)(Op, Storage& dst, Storage& src);
+
+    ///
+    /// per closure type call / move / destroy functions, Small selects the inline layout
+    ///
+    template <typename T, bool Small = (sizeof(T) <= INLINE_SIZE && alignof(T) <= alignof(std::max_align_t))>
+    struct Manager {
+        static T*	get(Storage& s)	{ return reinterpret_cast<T*>(s.buffer); }
+
+        template <typename U>
+        static void	create(Storage& s, U&& u)	{ new(s.buffer) T(forward<U>(u)); }
+
+        static ReturnValue
+        invoke(Storage& s, Args&&... args) {
+            return (*get(s))(forward<Args>(args)...);
+        }
+
+        static void
+        manage(Op op, Storage& dst, Storage& src) {
+            if( op == MOVE ) {
+                new(dst.buffer) T(move(*get(src)));
+            }
+            get(src)->~T();
+        }
     };
 
     template <typename T>
-    class CallableT : public ICallable {
-    public:
-        CallableT(const T& t)
-            : t_(t) {
+    struct Manager<T, false> {
+        static T*	get(Storage& s)	{ return static_cast<T*>(s.heap); }
+
+        template <typename U>
+        static void
+        create(Storage& s, U&& u) {
+            void*	mem	= malloc(sizeof(T));
+            assert(mem != nullptr);
+            s.heap	= new(mem) T(forward<U>(u));
         }
 
-        ~CallableT() override = default;
+        static ReturnValue
+        invoke(Storage& s, Args&&... args) {
+            return (*get(s))(forward<Args>(args)...);
+        }
+
+        static void
+        manage(Op op, Storage& dst, Storage& src) {
+            if( op == MOVE ) {
+                dst.heap	= src.heap;	// ownership travels with the pointer
+                src.heap	= nullptr;
+            } else {
+                get(src)->~T();
+                free(src.heap);
+            }
+        }
+    };
+
+    template <typename T, typename U>
+    void
+    construct(U&& u) {
+        Manager<T>::create(storage_, forward<U>(u));
+        invoke_	= &Manager<T>::invoke;
+        manage_	= &Manager<T>::manage;
+    }
+
+    InvokeFn		invoke_;
+    ManageFn		manage_;
+    mutable Storage	storage_;
+};
+
+template <typename T>
+class FunctionRef;
+
+///
+/// non-owning reference to a callable: an object pointer and a trampoline. it never
+/// allocates, so it is the cheap way to take "any callable" as a parameter. the
+/// referenced callable must outlive every call made through the FunctionRef
+///
+template <typename ReturnValue, typename... Args>
+class FunctionRef<ReturnValue(Args...)> {
+public:
+    template <typename F, typename = typename EnableIf<!IsSame<typename _RemoveConst<typename _RemoveReference<F>::_type>::_type, FunctionRef>::value>::type>
+    FunctionRef(F&& f) : call_(&callObject<typename _RemoveReference<F>::_type>) {
+        target_.object	= const_cast<void*>(static_cast<const void*>(&f));
+    }
 
-        ReturnValue Invoke(Args... args) override {
-            return t_(args...);
+    FunctionRef(ReturnValue (*f)(Args...)) : call_(&callFunction) {
+        assert(f != nullptr);
+        target_.function	= reinterpret_cast<void (*)()>(f);
+    }
+
+    ReturnValue operator()(Args... args) const {
+        return call_(target_, forward<Args>(args)...);
+    }
+
+private:
+    union Target {
+        void*		object;
+        void		(*function)();
+    };
+
+    ///
+    /// calls f, a void FunctionRef throws away whatever f returns
+    ///
+    template <typename R, typename F>
+    struct Call {
+        static R
+        call(F& f, Args&&... args) {
+            return f(forward<Args>(args)...);
         }
+    };
 
-    private:
-        T t_;
+    template <typename F>
+    struct Call<void, F> {
+        static void
+        call(F& f, Args&&... args) {
+            f(forward<Args>(args)...);
+        }
     };
 
-    typename ICallable::OPtr callable_;
+    template <typename F>
+    static ReturnValue
+    callObject(Target t, Args&&... args) {
+        return Call<ReturnValue, F>::call(*static_cast<F*>(t.object), forward<Args>(args)...);
+    }
+
+    static ReturnValue
+    callFunction(Target t, Args&&... args) {
+        return reinterpret_cast<ReturnValue (*)(Args...)>(t.function)(forward<Args>(args)...);
+    }
+
+    Target		target_;
+    ReturnValue		(*call_)(Target, Args&&...);
 };
 }
 #endif // LAMBDA_HPP
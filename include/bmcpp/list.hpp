@@ -116,20 +116,25 @@ public:
 
     List(const List<T>& other) : length(0), head(nullptr), tail(nullptr)
     {
-        for( List<T>::ConstIterator it = other.cbegin(), end = other.cend();
-                it != end;
-                ++it )
-            push_back(*it);
+        appendCount(other.cbegin(), other.length);
+    }
+
+    ///
+    /// build a list of n elements in one pass, see append()
+    ///
+    List(const T* elems, size_t n) : length(0), head(nullptr), tail(nullptr)
+    {
+        appendCount(elems, n);
     }
 
     List<T>&
     operator = (const List<T>& other)
     {
-        clear();
-        for( List<T>::ConstIterator it = other.cbegin(), end = other.cend();
-                it != end;
-                ++it )
-            push_back(*it);
+        if( &other != this )
+        {
+            clear();
+            appendCount(other.cbegin(), other.length);
+        }
         return *this;
     }
 
@@ -138,28 +143,64 @@ public:
         clear();
     }
 
+    ///
+    /// destroy all the elements. the nodes are not unlinked one by one, and nodes
+    /// that came from the same append() batch are given back to it with a single
+    /// count update per run
+    ///
     void
     clear()
     {
         Node*		n	= head;
-        Node*		next	= nullptr;
+        NodeSlab*	run	= nullptr;
+        size_t		runCount	= 0;
         while( n )
         {
-            next	= n->next;
+            Node*	next	= n->next;
+            NodeSlab*	slab	= n->slab;
+            n->~Node();
 
-            if( n && n == head )
-                head		= n->next;
+            if( slab != run )
+            {
+                if( run )
+                    releaseSlabNodes(run, runCount);
+                run		= slab;
+                runCount	= 0;
+            }
 
-            if( n && n == tail )
-                tail		= n->prev;
-
-            // prev & next are setup upon node deletion
-            delete n;
-
-            --length;
+            if( slab )
+                ++runCount;
+            else
+                Node::operator delete(n);
 
             n	= next;
         }
+
+        if( run )
+            releaseSlabNodes(run, runCount);
+
+        head	= tail	= nullptr;
+        length	= 0;
+    }
+
+    ///
+    /// append the elements of [first, last). the nodes are carved out of contiguous
+    /// batches of at most SLAB_SIZE bytes, each sized to the elements still to come, so
+    /// building a long list costs a few allocations instead of one per element, and
+    /// walking it right after stays sequential in memory. ranges shorter than
+    /// MIN_SLAB_NODES get plain nodes. batch nodes behave like any other node (erase,
+    /// splice, sort, ...), a batch is freed when its last node is
+    /// @param first the first element to copy
+    /// @param last the end of the range, It is walked twice to size the batches
+    ///
+    template<typename It>
+    void
+    append(It first, It last)
+    {
+        size_t	n	= 0;
+        for( It i = first; i != last; ++i )
+            ++n;
+        appendCount(first, n);
     }
 
     void
@@ -184,14 +225,17 @@ public:
     erase(ConstIterator pos)
     {
         Node*		n	= pos.n;
-        if( n && n == head )
+        if( n == head )
             head		= n->next;
+        else
+            n->prev->next	= n->next;
 
-        if( n && n == tail )
+        if( n == tail )
             tail		= n->prev;
+        else
+            n->next->prev	= n->prev;
 
-        // prev & next are setup upon node deletion
-        delete n;
+        releaseNode(n);
         --length;
     }
 
@@ -274,16 +318,283 @@ public:
         return (head->data);
     }
 
+    ///
+    /// move all the nodes of other before pos, in O(1). nothing is copied or allocated,
+    /// iterators to the moved nodes must be refetched from this list
+    /// @param pos the position to insert the nodes before
+    /// @param other the list to empty, must not be this list
+    ///
+    void
+    splice(Iterator pos, List<T>& other)
+    {
+        assert(&other != this);
+        if( other.empty() )
+            return;
+
+        Node*	first	= other.head;
+        Node*	last	= other.tail;
+        size_t	n	= other.length;
+        other.unlinkRange(first, last, n);
+        linkRange(pos.n, first, last, n);
+    }
+
+    ///
+    /// move the single node at it from other before pos, in O(1)
+    /// @param pos the position to insert the node before
+    /// @param other the list owning it, may be this list
+    /// @param it the node to move
+    ///
+    void
+    splice(Iterator pos, List<T>& other, Iterator it)
+    {
+        if( pos.n == it.n || (pos.n && pos.n->prev == it.n) )
+            return;	// already in place
+
+        other.unlinkRange(it.n, it.n, 1);
+        linkRange(pos.n, it.n, it.n, 1);
+    }
+
+    ///
+    /// move the nodes [first, last) from other before pos, in O(1)
+    /// @param pos the position to insert the nodes before, must not be inside [first, last)
+    /// @param other the list owning the range, may be this list
+    /// @param first the first node to move
+    /// @param last the node after the last one to move
+    /// @param count the number of nodes in [first, last)
+    ///
+    void
+    splice(Iterator pos, List<T>& other, Iterator first, Iterator last, size_t count)
+    {
+        if( first == last )
+            return;
+
+        Node*	lastNode	= last.n ? last.n->prev : other.tail;
+        other.unlinkRange(first.n, lastNode, count);
+        linkRange(pos.n, first.n, lastNode, count);
+    }
+
+    ///
+    /// move the nodes [first, last) from other before pos, linear in the range length
+    /// when other is another list (to keep both sizes right), O(1) otherwise
+    ///
+    void
+    splice(Iterator pos, List<T>& other, Iterator first, Iterator last)
+    {
+        size_t	count	= 0;
+        if( &other != this )
+            for( Iterator it = first; it != last; ++it )
+                ++count;
+        splice(pos, other, first, last, count);
+    }
+
+    ///
+    /// merge the sorted list other into this sorted list in linear time, other ends up empty.
+    /// the merge is stable: of two equivalent elements, the one from this list comes first
+    /// @param other the list to merge, must not be this list
+    /// @param less the ordering both lists are sorted by
+    ///
+    template<typename Less_>
+    void
+    merge(List<T>& other, Less_ less)
+    {
+        assert(&other != this);
+        if( other.empty() )
+            return;
+
+        head	= mergeChains(head, other.head, less);
+        length	+= other.length;
+        other.head	= other.tail	= nullptr;
+        other.length	= 0;
+        relinkPrev();
+    }
+
+    void
+    merge(List<T>& other)
+    {
+        merge(other, Less<T>());
+    }
+
+    ///
+    /// stable bottom-up merge sort in O(n log n) time and O(1) space. nodes are relinked,
+    /// elements are never copied
+    /// @param less the strict weak ordering to sort by
+    ///
+    template<typename Less_>
+    void
+    sort(Less_ less)
+    {
+        if( length < 2 )
+            return;
+
+        // treat the list as singly linked through next and merge runs of width 1, 2, 4, ...
+        Node*	list	= head;
+        for( size_t width = 1; ; width *= 2 )
+        {
+            Node*	p	= list;
+            Node*	last	= nullptr;
+            size_t	merges	= 0;
+            list	= nullptr;
+
+            while( p )
+            {
+                ++merges;
+                Node*	q	= p;
+                size_t	psize	= 0;
+                for( size_t i = 0; i < width && q; ++i )
+                {
+                    ++psize;
+                    q	= q->next;
+                }
+                size_t	qsize	= width;
+
+                while( psize > 0 || (qsize > 0 && q) )
+                {
+                    Node*	e;
+                    if( psize == 0 )
+                    {
+                        e	= q;
+                        q	= q->next;
+                        --qsize;
+                    }
+                    else if( qsize == 0 || !q || !less(q->data, p->data) )
+                    {
+                        e	= p;
+                        p	= p->next;
+                        --psize;
+                    }
+                    else
+                    {
+                        e	= q;
+                        q	= q->next;
+                        --qsize;
+                    }
+
+                    if( last )
+                        last->next	= e;
+                    else
+                        list		= e;
+                    last	= e;
+                }
+                p	= q;
+            }
+            last->next	= nullptr;
+
+            if( merges <= 1 )
+                break;
+        }
+
+        head	= list;
+        relinkPrev();
+    }
+
+    void
+    sort()
+    {
+        sort(Less<T>());
+    }
 
 private:
+    ///
+    /// detach the n nodes [first, last] from this list, their outer links are left dangling
+    ///
+    void
+    unlinkRange(Node* first, Node* last, size_t n)
+    {
+        if( first->prev )
+            first->prev->next	= last->next;
+        else
+            head			= last->next;
 
-    struct Node : BaseAllocation
+        if( last->next )
+            last->next->prev	= first->prev;
+        else
+            tail			= first->prev;
+
+        length	-= n;
+    }
+
+    ///
+    /// link the n detached nodes [first, last] before pos (nullptr for the end)
+    ///
+    void
+    linkRange(Node* pos, Node* first, Node* last, size_t n)
     {
-        Node*		prev;
-        Node*		next;
-        T		data;
+        Node*	prev	= pos ? pos->prev : tail;
+        first->prev	= prev;
+        last->next	= pos;
+
+        if( prev )
+            prev->next	= first;
+        else
+            head		= first;
+
+        if( pos )
+            pos->prev	= last;
+        else
+            tail		= last;
+
+        length	+= n;
+    }
 
-        Node(Node* prev, Node* next, const T& t) : prev(prev), next(next), data(t)
+    ///
+    /// merge two sorted next chains, ties taken from a
+    ///
+    template<typename Less_>
+    static Node*
+    mergeChains(Node* a, Node* b, Less_& less)
+    {
+        Node*	first	= nullptr;
+        Node*	last	= nullptr;
+        while( a && b )
+        {
+            Node*	e;
+            if( less(b->data, a->data) )
+            {
+                e	= b;
+                b	= b->next;
+            }
+            else
+            {
+                e	= a;
+                a	= a->next;
+            }
+
+            if( last )
+                last->next	= e;
+            else
+                first		= e;
+            last	= e;
+        }
+
+        Node*	rest	= a ? a : b;
+        if( last )
+            last->next	= rest;
+        else
+            first		= rest;
+        return first;
+    }
+
+    ///
+    /// rebuild the prev links and the tail after the next chain from head was rewired
+    ///
+    void
+    relinkPrev()
+    {
+        Node*	prev	= nullptr;
+        for( Node* n = head; n; n = n->next )
+        {
+            n->prev	= prev;
+            prev	= n;
+        }
+        tail	= prev;
+    }
+
+
+    struct NodeSlab;
+
+    struct Node : BaseAllocation
+    {
+        Node(Node* prev, Node* next, const T& t) : prev(prev), next(next), slab(nullptr), data(t)
         {
             if( prev )
                 prev->next	= this;
@@ -291,15 +602,108 @@ private:
                 next->prev	= this;
         }
 
-        ~Node()
+        Node*		prev;
+        Node*		next;
+        NodeSlab*	slab;	///< the batch this node was carved from, nullptr for a node allocated on its own
+        T		data;
+    };
+
+    ///
+    /// header of a batch of nodes. live is atomic because splice can hand nodes of the
+    /// same batch to lists owned by different threads
+    ///
+    struct NodeSlab
+    {
+        std::atomic<size_t>	live;
+    };
+
+    enum
+    {
+        SLAB_SIZE	= 16384,
+        MIN_SLAB_NODES	= 16,
+        SLAB_FIRST	= (sizeof(NodeSlab) + alignof(Node) - 1) / alignof(Node) * alignof(Node),
+        SLAB_NODES	= (SLAB_SIZE - SLAB_FIRST) / sizeof(Node)
+    };
+
+    ///
+    /// append the count elements starting at first, see append()
+    ///
+    template<typename It>
+    void
+    appendCount(It first, size_t count)
+    {
+        while( count )
         {
-            if( prev )
-                prev->next	= next;
+            if( SLAB_NODES < MIN_SLAB_NODES || count < MIN_SLAB_NODES )
+            {
+                linkBack(new Node(tail, nullptr, *first));
+                ++first;
+                --count;
+                continue;
+            }
 
-            if( next )
-                next->prev	= prev;
+            size_t		nodes	= count < size_t(SLAB_NODES) ? count : size_t(SLAB_NODES);
+            NodeSlab*	slab	= allocSlab(nodes);
+            for( size_t i = 0; i < nodes; ++i, ++first )
+            {
+                Node*	n	= new(slotOf(slab, i)) Node(tail, nullptr, *first);
+                n->slab	= slab;
+                linkBack(n);
+            }
+            slab->live.store(nodes, std::memory_order_release);
+            count	-= nodes;
         }
-    };
+    }
+
+    void
+    linkBack(Node* n)
+    {
+        if( !head )
+            head	= n;
+        tail	= n;
+        ++length;
+    }
+
+    ///
+    /// a batch for nodes nodes, just big enough to hold them
+    ///
+    static NodeSlab*
+    allocSlab(size_t nodes)
+    {
+        void*	mem	= malloc(SLAB_FIRST + nodes * sizeof(Node));
+        assert(mem != nullptr && reinterpret_cast<uintptr_t>(mem) % alignof(Node) == 0);
+        return new(mem) NodeSlab();
+    }
+
+    static Node*
+    slotOf(NodeSlab* slab, size_t i)
+    {
+        return reinterpret_cast<Node*>(reinterpret_cast<char*>(slab) + SLAB_FIRST) + i;
+    }
+
+    static void
+    releaseSlabNodes(NodeSlab* slab, size_t n)
+    {
+        if( slab->live.fetch_sub(n, std::memory_order_acq_rel) == n )
+        {
+            slab->~NodeSlab();
+            free(slab);
+        }
+    }
+
+    ///
+    /// destroy and deallocate an already unlinked node
+    ///
+    static void
+    releaseNode(Node* n)
+    {
+        NodeSlab*	slab	= n->slab;
+        n->~Node();
+        if( slab )
+            releaseSlabNodes(slab, 1);
+        else
+            Node::operator delete(n);
+    }
 
     size_t			length;
     Node*			head;
@@ -308,4 +712,635 @@ private:
     template<typename I>
     friend struct BaseIterator;
 };	// struct list
+
+///
+/// the links of an IntrusiveList, embedded as a member of the listed object.
+/// copying an object does not copy its membership: the copy starts unlinked
+///
+struct ListHook
+{
+    ListHook() : prev(nullptr), next(nullptr)	{}
+    ListHook(const ListHook&) : prev(nullptr), next(nullptr)	{}
+
+    ~ListHook()
+    {
+        assert(!isLinked() && "object destroyed while still in an IntrusiveList");
+    }
+
+    ListHook&
+    operator = (const ListHook&)
+    {
+        return *this;
+    }
+
+    bool
+    isLinked() const
+    {
+        return next != nullptr;
+    }
+
+private:
+    ListHook*	prev;
+    ListHook*	next;
+
+    template<typename T, ListHook T::*Hook>
+    friend struct IntrusiveList;
+};
+
+///
+/// doubly linked list threaded through a ListHook member of the elements:
+///
+///     struct Timer { ListHook hook; ... };
+///     IntrusiveList<Timer, &Timer::hook> timers;
+///
+/// the list never allocates and never owns its elements, it only links them.
+/// an element can be in as many lists at once as it has hooks, and erase only
+/// needs the element itself
+///
+template<typename T, ListHook T::*Hook>
+struct IntrusiveList : private NonCopyable
+{
+    template<typename I>
+    struct BaseIterator
+    {
+        BaseIterator()	: h(nullptr)	{}
+
+        BaseIterator<I>&
+        operator++()
+        {
+            h	= h->next;
+            return *this;
+        }
+
+        BaseIterator<I>
+        operator++(int)
+        {
+            BaseIterator<I>	tmp(h);
+            h	= h->next;
+            return tmp;
+        }
+
+        BaseIterator<I>&
+        operator--()
+        {
+            h	= h->prev;
+            return *this;
+        }
+
+        BaseIterator<I>
+        operator--(int)
+        {
+            BaseIterator<I>	tmp(h);
+            h	= h->prev;
+            return tmp;
+        }
+
+        I&
+        operator *() const
+        {
+            return *fromHook(h);
+        }
+
+        I*
+        operator ->() const
+        {
+            return fromHook(h);
+        }
+
+        template<typename O>
+        bool
+        operator == (const BaseIterator<O>& it) const
+        {
+            return h == it.h;
+        }
+
+        template<typename O>
+        bool
+        operator != (const BaseIterator<O>& it) const
+        {
+            return h != it.h;
+        }
+
+        operator BaseIterator<const I> () const
+        {
+            return BaseIterator<const I>(h);
+        }
+
+    private:
+        explicit BaseIterator(ListHook* h)	: h(h)	{}
+        ListHook*	h;
+        friend struct	IntrusiveList;
+    };
+
+    typedef BaseIterator<T> Iterator;
+    typedef BaseIterator<const T> ConstIterator;
+
+    IntrusiveList() : length(0)
+    {
+        sentinel.prev	= &sentinel;
+        sentinel.next	= &sentinel;
+    }
+
+    ~IntrusiveList()
+    {
+        clear();
+        sentinel.prev	= nullptr;
+        sentinel.next	= nullptr;
+    }
+
+    ///
+    /// unlink every element, the elements themselves are left alone
+    ///
+    void
+    clear()
+    {
+        ListHook*	h	= sentinel.next;
+        while( h != &sentinel )
+        {
+            ListHook*	next	= h->next;
+            h->prev	= nullptr;
+            h->next	= nullptr;
+            h	= next;
+        }
+        sentinel.prev	= &sentinel;
+        sentinel.next	= &sentinel;
+        length		= 0;
+    }
+
+    void
+    push_back(T& t)
+    {
+        insert(end(), t);
+    }
+
+    void
+    push_front(T& t)
+    {
+        insert(begin(), t);
+    }
+
+    void
+    pop_back()
+    {
+        erase(*fromHook(sentinel.prev));
+    }
+
+    void
+    pop_front()
+    {
+        erase(*fromHook(sentinel.next));
+    }
+
+    ///
+    /// insert an element before the pos iterator
+    /// @param pos the position to insert the element before
+    /// @param t the element to link, it must not be in a list through this hook
+    /// @return an iterator to t
+    ///
+    Iterator
+    insert(Iterator pos, T& t)
+    {
+        ListHook*	h	= &(t.*Hook);
+        assert(!h->isLinked());
+
+        h->next		= pos.h;
+        h->prev		= pos.h->prev;
+        h->prev->next	= h;
+        pos.h->prev	= h;
+        ++length;
+        return Iterator(h);
+    }
+
+    ///
+    /// unlink t from the list in O(1)
+    /// @param t an element of this list
+    /// @return an iterator to the element that followed t
+    ///
+    Iterator
+    erase(T& t)
+    {
+        ListHook*	h	= &(t.*Hook);
+        ListHook*	next	= h->next;
+        assert(h->isLinked());
+
+        h->prev->next	= next;
+        next->prev	= h->prev;
+        h->prev		= nullptr;
+        h->next		= nullptr;
+        --length;
+        return Iterator(next);
+    }
+
+    Iterator
+    erase(Iterator pos)
+    {
+        return erase(*pos);
+    }
+
+    ///
+    /// @return an iterator to t, which must be in this list
+    ///
+    Iterator
+    iteratorTo(T& t) const
+    {
+        return Iterator(&(t.*Hook));
+    }
+
+    Iterator
+    begin() const
+    {
+        return Iterator(sentinel.next);
+    }
+
+    Iterator
+    end() const
+    {
+        return Iterator(const_cast<ListHook*>(&sentinel));
+    }
+
+    ConstIterator
+    cbegin() const
+    {
+        return ConstIterator(sentinel.next);
+    }
+
+    ConstIterator
+    cend() const
+    {
+        return ConstIterator(const_cast<ListHook*>(&sentinel));
+    }
+
+    size_t
+    size() const
+    {
+        return length;
+    }
+
+    bool
+    empty() const
+    {
+        return length == 0;
+    }
+
+    T&
+    front() const
+    {
+        return *fromHook(sentinel.next);
+    }
+
+    T&
+    back() const
+    {
+        return *fromHook(sentinel.prev);
+    }
+
+private:
+    static T*
+    fromHook(ListHook* h)
+    {
+        // offset of the hook member, computed from a fake object address
+        const size_t	offset	= reinterpret_cast<size_t>(&(reinterpret_cast<T*>(size_t(0x1000))->*Hook)) - size_t(0x1000);
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(h) - offset);
+    }
+
+    ListHook	sentinel;
+    size_t		length;
+};	// struct IntrusiveList
+
+///
+/// sequence of fixed size blocks of K elements with linked block headers (an unrolled list).
+/// push/pop are O(1) at both ends, elements never move once inserted, and iteration walks
+/// contiguous memory for K elements at a time instead of chasing one pointer per element.
+/// the default K makes each block about 512 bytes
+///
+template<typename T, size_t K = (sizeof(T) < 64 ? 512 / sizeof(T) : 8)>
+struct ChunkedList : BaseAllocation
+{
+private:
+    struct Block;
+public:
+    template<typename I>
+    struct BaseIterator
+    {
+        BaseIterator()	: b(nullptr), i(0)	{}
+
+        BaseIterator<I>&
+        operator++()
+        {
+            if( ++i == b->end && b->next )
+            {
+                b	= b->next;
+                i	= b->begin;
+            }
+            return *this;
+        }
+
+        BaseIterator<I>
+        operator++(int)
+        {
+            BaseIterator<I>	tmp(*this);
+            ++(*this);
+            return tmp;
+        }
+
+        BaseIterator<I>&
+        operator--()
+        {
+            if( i == b->begin && b->prev )
+            {
+                b	= b->prev;
+                i	= b->end;
+            }
+            --i;
+            return *this;
+        }
+
+        BaseIterator<I>
+        operator--(int)
+        {
+            BaseIterator<I>	tmp(*this);
+            --(*this);
+            return tmp;
+        }
+
+        I&
+        operator *() const
+        {
+            return b->items()[i];
+        }
+
+        I*
+        operator ->() const
+        {
+            return &(b->items()[i]);
+        }
+
+        template<typename O>
+        bool
+        operator == (const BaseIterator<O>& it) const
+        {
+            return b == it.b && i == it.i;
+        }
+
+        template<typename O>
+        bool
+        operator != (const BaseIterator<O>& it) const
+        {
+            return b != it.b || i != it.i;
+        }
+
+        operator BaseIterator<const I> () const
+        {
+            return BaseIterator<const I>(b, i);
+        }
+
+    private:
+        BaseIterator(Block* b, size_t i)	: b(b), i(i)	{}
+        Block*		b;
+        size_t		i;
+        friend struct	ChunkedList;
+    };
+
+    typedef BaseIterator<T> Iterator;
+    typedef BaseIterator<const T> ConstIterator;
+
+    ChunkedList() : length(0), head(nullptr), tail(nullptr), spare(nullptr)	{}
+
+    ChunkedList(const ChunkedList& other) : length(0), head(nullptr), tail(nullptr), spare(nullptr)
+    {
+        for( ConstIterator it = other.cbegin(), end = other.cend(); it != end; ++it )
+            push_back(*it);
+    }
+
+    ChunkedList&
+    operator = (const ChunkedList& other)
+    {
+        if( &other != this )
+        {
+            clear();
+            for( ConstIterator it = other.cbegin(), end = other.cend(); it != end; ++it )
+                push_back(*it);
+        }
+        return *this;
+    }
+
+    ~ChunkedList()
+    {
+        clear();
+        free(spare);
+    }
+
+    void
+    clear()
+    {
+        Block*	b	= head;
+        while( b )
+        {
+            Block*	next	= b->next;
+            T*	items	= b->items();
+            for( size_t i = b->begin; i < b->end; ++i )
+                items[i].~T();
+            releaseBlock(b);
+            b	= next;
+        }
+        head	= tail	= nullptr;
+        length	= 0;
+    }
+
+    void
+    push_back(const T& t)
+    {
+        if( !tail || tail->end == K )
+        {
+            Block*	b	= acquireBlock(0);
+            b->prev	= tail;
+            if( tail )
+                tail->next	= b;
+            else
+                head		= b;
+            tail	= b;
+        }
+        new(&(tail->items()[tail->end])) T(t);
+        ++tail->end;
+        ++length;
+    }
+
+    void
+    push_front(const T& t)
+    {
+        if( !head || head->begin == 0 )
+        {
+            Block*	b	= acquireBlock(K);
+            b->next	= head;
+            if( head )
+                head->prev	= b;
+            else
+                tail		= b;
+            head	= b;
+        }
+        new(&(head->items()[head->begin - 1])) T(t);
+        --head->begin;
+        ++length;
+    }
+
+    void
+    pop_back()
+    {
+        assert(length);
+        --tail->end;
+        tail->items()[tail->end].~T();
+        --length;
+        if( tail->begin == tail->end )
+        {
+            Block*	b	= tail;
+            tail	= b->prev;
+            if( tail )
+                tail->next	= nullptr;
+            else
+                head		= nullptr;
+            releaseBlock(b);
+        }
+    }
+
+    void
+    pop_front()
+    {
+        assert(length);
+        head->items()[head->begin].~T();
+        ++head->begin;
+        --length;
+        if( head->begin == head->end )
+        {
+            Block*	b	= head;
+            head	= b->next;
+            if( head )
+                head->prev	= nullptr;
+            else
+                tail		= nullptr;
+            releaseBlock(b);
+        }
+    }
+
+    T&
+    front() const
+    {
+        return head->items()[head->begin];
+    }
+
+    T&
+    back() const
+    {
+        return tail->items()[tail->end - 1];
+    }
+
+    ///
+    /// element access, O(number of blocks)
+    ///
+    T&
+    operator[] (size_t i) const
+    {
+        Block*	b	= head;
+        while( i >= b->end - b->begin )
+        {
+            i	-= b->end - b->begin;
+            b	= b->next;
+        }
+        return b->items()[b->begin + i];
+    }
+
+    ///
+    /// call fn(T* items, size_t count) on each contiguous run of elements, in order
+    ///
+    template<typename Fn>
+    void
+    foreachChunk(Fn&& fn) const
+    {
+        for( Block* b = head; b; b = b->next )
+            fn(b->items() + b->begin, b->end - b->begin);
+    }
+
+    Iterator
+    begin() const
+    {
+        return head ? Iterator(head, head->begin) : Iterator();
+    }
+
+    Iterator
+    end() const
+    {
+        return tail ? Iterator(tail, tail->end) : Iterator();
+    }
+
+    ConstIterator
+    cbegin() const
+    {
+        return begin();
+    }
+
+    ConstIterator
+    cend() const
+    {
+        return end();
+    }
+
+    size_t
+    size() const
+    {
+        return length;
+    }
+
+    bool
+    empty() const
+    {
+        return length == 0;
+    }
+
+private:
+    struct Block
+    {
+        Block*		prev;
+        Block*		next;
+        size_t		begin;	///< first live slot
+        size_t		end;	///< one past the last live slot
+        alignas(T) unsigned char	raw[K * sizeof(T)];
+
+        T*	items()		{ return reinterpret_cast<T*>(raw);	}
+    };
+
+    ///
+    /// get an empty block whose live range starts and ends at pos
+    ///
+    Block*
+    acquireBlock(size_t pos)
+    {
+        Block*	b	= spare;
+        if( b )
+            spare	= nullptr;
+        else
+            b	= static_cast<Block*>(malloc(sizeof(Block)));
+        assert(b != nullptr);
+        b->prev		= nullptr;
+        b->next		= nullptr;
+        b->begin	= pos;
+        b->end		= pos;
+        return b;
+    }
+
+    ///
+    /// keep one empty block around so a queue oscillating on a block boundary does not hit malloc
+    ///
+    void
+    releaseBlock(Block* b)
+    {
+        if( spare )
+            free(b);
+        else
+            spare	= b;
+    }
+
+    size_t		length;
+    Block*		head;
+    Block*		tail;
+    Block*		spare;
+};	// struct ChunkedList
 }	// namespace BmCpp
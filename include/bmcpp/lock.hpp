@@ -0,0 +1,503 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <ctime>
+#include <sched.h>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace BmCpp {
+
+///
+/// a hint to the core that we are busy waiting
+///
+inline void
+cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield" ::: "memory");
+#else
+    __asm__ __volatile__("" ::: "memory");
+#endif
+}
+
+///
+/// exponential backoff for spin loops. once the pause count reaches MAX_SPINS the
+/// waiter gives its time slice away instead, so a preempted lock holder can run
+///
+struct Backoff
+{
+    enum
+    {
+        MAX_SPINS	= 64
+    };
+
+    Backoff() : spins(1)	{}
+
+    void
+    pause() {
+        if( spins <= MAX_SPINS ) {
+            for( uint32_t i = 0; i < spins; ++i )
+                cpuRelax();
+            spins	<<= 1;
+        } else {
+            sched_yield();
+        }
+    }
+
+    uint32_t	spins;
+};
+
+///
+/// lock profiling policies. locks call acquired() on the fast path and, when they had
+/// to wait, begin() before and contended(start) once they own the lock. NoLockStats
+/// compiles all of it away; LockStats counts acquisitions and contentions and sums
+/// the time spent waiting. counters are only written by the lock owner, so they are
+/// relaxed load + store pairs rather than read-modify-writes
+///
+struct NoLockStats
+{
+    void		acquired()		{}
+    uint64_t		begin() const		{ return 0;	}
+    void		contended(uint64_t)	{}
+};
+
+struct LockStats
+{
+    LockStats() : acquisitions_(0), contentions_(0), waitNs_(0), maxWaitNs_(0)	{}
+
+    void	acquired()	{ bump(acquisitions_, 1); }
+
+    uint64_t	begin() const	{ return now();	}
+
+    void
+    contended(uint64_t start) {
+        uint64_t	wait	= now() - start;
+        bump(acquisitions_, 1);
+        bump(contentions_, 1);
+        bump(waitNs_, wait);
+        if( wait > maxWaitNs_.load(std::memory_order_relaxed) )
+            maxWaitNs_.store(wait, std::memory_order_relaxed);
+    }
+
+    uint64_t	acquisitions() const	{ return acquisitions_.load(std::memory_order_relaxed);	}
+    uint64_t	contentions() const	{ return contentions_.load(std::memory_order_relaxed);	}
+    uint64_t	waitNs() const		{ return waitNs_.load(std::memory_order_relaxed);	}
+    uint64_t	maxWaitNs() const	{ return maxWaitNs_.load(std::memory_order_relaxed);	}
+
+    ///
+    /// only meaningful while nobody holds the lock
+    ///
+    void
+    reset() {
+        acquisitions_.store(0, std::memory_order_relaxed);
+        contentions_.store(0, std::memory_order_relaxed);
+        waitNs_.store(0, std::memory_order_relaxed);
+        maxWaitNs_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    static uint64_t
+    now() {
+        struct timespec	ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return uint64_t(ts.tv_sec) * 1000000000ull + uint64_t(ts.tv_nsec);
+    }
+
+    static void	bump(std::atomic<uint64_t>& c, uint64_t n)	{ c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+
+    std::atomic<uint64_t>	acquisitions_;
+    std::atomic<uint64_t>	contentions_;
+    std::atomic<uint64_t>	waitNs_;
+    std::atomic<uint64_t>	maxWaitNs_;
+};
+
+///
+/// test and test-and-set spin lock with exponential backoff: waiters spin on a plain
+/// load so the line stays shared until the owner releases it
+///
+template<typename Stats = NoLockStats>
+struct SpinLock : private NonCopyable
+{
+    SpinLock() : state(0)	{}
+
+    bool
+    tryLock() {
+        if( !tryAcquire() )
+            return false;
+        stats_.acquired();
+        return true;
+    }
+
+    void
+    lock() {
+        if( tryAcquire() ) {
+            stats_.acquired();
+            return;
+        }
+        uint64_t	start	= stats_.begin();
+        Backoff		backoff;
+        do {
+            while( state.load(std::memory_order_relaxed) )
+                backoff.pause();
+        } while( state.exchange(1, std::memory_order_acquire) );
+        stats_.contended(start);
+    }
+
+    void	unlock()	{ state.store(0, std::memory_order_release); }
+
+    const Stats&	stats() const	{ return stats_;	}
+    Stats&		stats()		{ return stats_;	}
+
+private:
+    bool	tryAcquire()	{ return state.load(std::memory_order_relaxed) == 0 && state.exchange(1, std::memory_order_acquire) == 0; }
+
+    std::atomic<uint32_t>	state;
+    Stats			stats_;
+};
+
+///
+/// FIFO spin lock: waiters take a ticket and wait for it to be served, backing off in
+/// proportion to their distance from the head of the line. like McsLock it hands the
+/// lock to the next waiter in line even when that thread is not running, so keep it
+/// for locks with no more contenders than cores
+///
+template<typename Stats = NoLockStats>
+struct TicketLock : private NonCopyable
+{
+    TicketLock() : next(0), serving(0)	{}
+
+    bool
+    tryLock() {
+        uint32_t	s	= serving.load(std::memory_order_acquire);
+        uint32_t	n	= s;
+        if( next.compare_exchange_strong(n, s + 1, std::memory_order_acquire, std::memory_order_relaxed) ) {
+            stats_.acquired();
+            return true;
+        }
+        return false;
+    }
+
+    void
+    lock() {
+        uint32_t	ticket	= next.fetch_add(1, std::memory_order_relaxed);
+        uint32_t	s	= serving.load(std::memory_order_acquire);
+        if( s == ticket ) {
+            stats_.acquired();
+            return;
+        }
+        uint64_t	start	= stats_.begin();
+        uint32_t	rounds	= 0;
+        do {
+            // a waiter far back in line has no business hammering the line
+            for( uint32_t i = (ticket - s) * 16; i > 0; --i )
+                cpuRelax();
+            if( ++rounds > 8 )
+                sched_yield();
+            s	= serving.load(std::memory_order_acquire);
+        } while( s != ticket );
+        stats_.contended(start);
+    }
+
+    void	unlock()	{ serving.store(serving.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    const Stats&	stats() const	{ return stats_;	}
+    Stats&		stats()		{ return stats_;	}
+
+private:
+    std::atomic<uint32_t>	next;
+    char			pad[CACHE_LINE_SIZE - sizeof(std::atomic<uint32_t>)];
+    std::atomic<uint32_t>	serving;
+    Stats			stats_;
+};
+
+///
+/// MCS queue lock: every waiter spins on its own Node, so a release touches a single
+/// waiter's cache line however many threads are queued. the Node lives on the
+/// caller's stack for the whole critical section
+///
+template<typename Stats = NoLockStats>
+struct McsLock : private NonCopyable
+{
+    struct Node
+    {
+        Node() : next(nullptr), locked(false)	{}
+
+        std::atomic<Node*>	next;
+        std::atomic<bool>	locked;
+    };
+
+    ///
+    /// scoped acquisition holding its own queue node
+    ///
+    struct Guard : private NonCopyable
+    {
+        explicit Guard(McsLock& l) : lock(l)	{ lock.lock(node); }
+        ~Guard()				{ lock.unlock(node); }
+
+        McsLock&	lock;
+        Node		node;
+    };
+
+    McsLock() : tail(nullptr)	{}
+
+    bool
+    tryLock(Node& n) {
+        n.next.store(nullptr, std::memory_order_relaxed);
+        Node*	expected	= nullptr;
+        if( tail.compare_exchange_strong(expected, &n, std::memory_order_acq_rel, std::memory_order_relaxed) ) {
+            stats_.acquired();
+            return true;
+        }
+        return false;
+    }
+
+    void
+    lock(Node& n) {
+        n.next.store(nullptr, std::memory_order_relaxed);
+        n.locked.store(true, std::memory_order_relaxed);
+        Node*	prev	= tail.exchange(&n, std::memory_order_acq_rel);
+        if( !prev ) {
+            stats_.acquired();
+            return;
+        }
+        uint64_t	start	= stats_.begin();
+        prev->next.store(&n, std::memory_order_release);
+        Backoff		backoff;
+        while( n.locked.load(std::memory_order_acquire) )
+            backoff.pause();
+        stats_.contended(start);
+    }
+
+    void
+    unlock(Node& n) {
+        Node*	succ	= n.next.load(std::memory_order_acquire);
+        if( !succ ) {
+            Node*	expected	= &n;
+            if( tail.compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel, std::memory_order_relaxed) )
+                return;
+            // a successor swapped itself in but has not linked up yet
+            Backoff	backoff;
+            while( !(succ = n.next.load(std::memory_order_acquire)) )
+                backoff.pause();
+        }
+        succ->locked.store(false, std::memory_order_release);
+    }
+
+    const Stats&	stats() const	{ return stats_;	}
+    Stats&		stats()		{ return stats_;	}
+
+private:
+    std::atomic<Node*>	tail;
+    Stats		stats_;
+};
+
+///
+/// spins for a while, then sleeps in the kernel (a futex on Linux, sched_yield
+/// elsewhere). state is 0 free, 1 locked, 2 locked with possible sleepers, so an
+/// uncontended unlock never makes a system call
+///
+template<typename Stats = NoLockStats>
+struct AdaptiveMutex : private NonCopyable
+{
+    enum
+    {
+        SPIN_TRIES	= 100
+    };
+
+    AdaptiveMutex() : state(0)	{}
+
+    bool
+    tryLock() {
+        if( !tryAcquire() )
+            return false;
+        stats_.acquired();
+        return true;
+    }
+
+    void
+    lock() {
+        if( tryAcquire() ) {
+            stats_.acquired();
+            return;
+        }
+        uint64_t	start	= stats_.begin();
+        for( int i = 0; i < SPIN_TRIES; ++i ) {
+            cpuRelax();
+            uint32_t	expected	= 0;
+            if( state.load(std::memory_order_relaxed) == 0 &&
+                state.compare_exchange_weak(expected, 1, std::memory_order_acquire, std::memory_order_relaxed) ) {
+                stats_.contended(start);
+                return;
+            }
+        }
+        // from here on we may be sleeping, so always leave 2 behind for unlock()
+        while( state.exchange(2, std::memory_order_acquire) != 0 )
+            wait();
+        stats_.contended(start);
+    }
+
+    void
+    unlock() {
+        if( state.exchange(0, std::memory_order_release) == 2 )
+            wake();
+    }
+
+    const Stats&	stats() const	{ return stats_;	}
+    Stats&		stats()		{ return stats_;	}
+
+private:
+    bool
+    tryAcquire() {
+        uint32_t	expected	= 0;
+        return state.compare_exchange_strong(expected, 1, std::memory_order_acquire, std::memory_order_relaxed);
+    }
+
+#if defined(__linux__)
+    void	wait()	{ syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAIT_PRIVATE, 2, nullptr, nullptr, 0); }
+    void	wake()	{ syscall(SYS_futex, reinterpret_cast<uint32_t*>(&state), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0); }
+#else
+    void	wait()	{ sched_yield(); }
+    void	wake()	{}
+#endif
+
+    std::atomic<uint32_t>	state;
+    Stats			stats_;
+};
+
+///
+/// sequence lock: writers are serialized by a SpinLock and make the sequence odd while
+/// they write, readers never write shared memory and retry when the sequence moved.
+/// readBegin()/readRetry() bracket a read of data that is itself made of atomics,
+/// see SeqLocked for a ready made value holder
+///
+template<typename Stats = NoLockStats>
+struct SeqLock : private NonCopyable
+{
+    SeqLock() : seq(0), retries_(0)	{}
+
+    void
+    writeLock() {
+        writer.lock();
+        seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+    }
+
+    void	writeUnlock()	{ seq.store(seq.load(std::memory_order_relaxed) + 1, std::memory_order_release); writer.unlock(); }
+
+    ///
+    /// @return the sequence to hand to readRetry(), waits out a writer in progress
+    ///
+    uint32_t
+    readBegin() const {
+        uint32_t	s	= seq.load(std::memory_order_acquire);
+        if( s & 1 ) {
+            Backoff	backoff;
+            do {
+                backoff.pause();
+                s	= seq.load(std::memory_order_acquire);
+            } while( s & 1 );
+        }
+        return s;
+    }
+
+    ///
+    /// @return true if a writer ran since readBegin() returned s and the read must be redone
+    ///
+    bool
+    readRetry(uint32_t s) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if( seq.load(std::memory_order_relaxed) == s )
+            return false;
+        retries_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    ///
+    /// reader retries, a measure of how much writers disturb readers
+    ///
+    uint64_t		retries() const	{ return retries_.load(std::memory_order_relaxed);	}
+    const Stats&	stats() const	{ return writer.stats();	}
+
+private:
+    std::atomic<uint32_t>		seq;
+    mutable std::atomic<uint64_t>	retries_;
+    SpinLock<Stats>			writer;
+};
+
+///
+/// a trivially copyable T behind a SeqLock. the value is kept as relaxed atomic words
+/// so torn reads are retried rather than being data races
+///
+template<typename T, typename Stats = NoLockStats>
+struct SeqLocked : private NonCopyable
+{
+    explicit SeqLocked(const T& init = T())	{ put(init); }
+
+    T
+    load() const {
+        T	v;
+        uint32_t	s;
+        do {
+            s	= lock.readBegin();
+            get(v);
+        } while( lock.readRetry(s) );
+        return v;
+    }
+
+    void
+    store(const T& v) {
+        lock.writeLock();
+        put(v);
+        lock.writeUnlock();
+    }
+
+    const SeqLock<Stats>&	seqLock() const	{ return lock;	}
+
+private:
+    enum
+    {
+        WORDS	= (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t)
+    };
+
+    void
+    get(T& v) const {
+        uint64_t	buf[WORDS];
+        for( size_t i = 0; i < WORDS; ++i )
+            buf[i]	= words[i].load(std::memory_order_relaxed);
+        memcpy(&v, buf, sizeof(T));
+    }
+
+    void
+    put(const T& v) {
+        uint64_t	buf[WORDS]	= {};
+        memcpy(buf, &v, sizeof(T));
+        for( size_t i = 0; i < WORDS; ++i )
+            words[i].store(buf[i], std::memory_order_relaxed);
+    }
+
+    SeqLock<Stats>		lock;
+    std::atomic<uint64_t>	words[WORDS];
+};
+
+///
+/// scoped lock()/unlock() for any of the locks above except McsLock (see McsLock::Guard)
+///
+template<typename L>
+struct LockGuard : private NonCopyable
+{
+    explicit LockGuard(L& lock) : l(lock)	{ l.lock(); }
+    ~LockGuard()				{ l.unlock(); }
+
+    L&	l;
+};
+
+}	// namespace BmCpp
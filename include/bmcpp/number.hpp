@@ -0,0 +1,590 @@
+#pragma once
+
+#include <cstring>
+#include "cpp-rt.hpp"
+
+namespace BmCpp {
+
+///
+/// allocation free number <-> text conversions, working on plain char buffers.
+/// the String/StringView front ends live in string.hpp
+///
+enum
+{
+    MAX_INT_CHARS		= 20,	///< "-9223372036854775808" or "18446744073709551615"
+    MAX_DOUBLE_CHARS	= 25	///< "-2.2250738585072014e-308"
+};
+
+namespace Detail {
+
+static const char	DIGIT_PAIRS[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+///
+/// number of decimal digits of v, v > 0
+///
+inline unsigned
+countDigits(uint64_t v) {
+    static const uint64_t	POW10[20] = {
+        1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull, 10000000ull,
+        100000000ull, 1000000000ull, 10000000000ull, 100000000000ull, 1000000000000ull,
+        10000000000000ull, 100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+        100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+    };
+    // log10(v) ~= log2(v) * 1233 / 4096, then fix the estimate with a single compare
+    unsigned	t	= (64 - __builtin_clzll(v)) * 1233 >> 12;
+    return t - (v < POW10[t]) + 1;
+}
+
+///
+/// write exactly n digits of v backward from buf + n, two digits per step
+///
+inline void
+writeDigits(char* buf, uint64_t v, unsigned n) {
+    char*	p	= buf + n;
+    while( v >= 100 ) {
+        unsigned	idx	= unsigned(v % 100) * 2;
+        v	/= 100;
+        p	-= 2;
+        memcpy(p, DIGIT_PAIRS + idx, 2);
+    }
+
+    if( v >= 10 ) {
+        p	-= 2;
+        memcpy(p, DIGIT_PAIRS + v * 2, 2);
+    } else {
+        *--p	= char('0' + v);
+    }
+}
+
+//
+// Grisu2 round trip double printing, almost always shortest.
+//
+// Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers", PLDI 2010.
+// Layout follows Milo Yip's dtoa implementation (MIT license).
+//
+struct DiyFp
+{
+    DiyFp() : f(0), e(0)	{}
+    DiyFp(uint64_t f, int e) : f(f), e(e)	{}
+
+    explicit DiyFp(double d) {
+        uint64_t	bits;
+        memcpy(&bits, &d, sizeof(bits));
+        int		biased	= int((bits & EXP_MASK) >> 52);
+        uint64_t	frac	= bits & FRAC_MASK;
+        if( biased ) {
+            f	= frac + HIDDEN_BIT;
+            e	= biased - EXP_BIAS;
+        } else {
+            f	= frac;
+            e	= 1 - EXP_BIAS;
+        }
+    }
+
+    DiyFp
+    operator - (const DiyFp& rhs) const	{ return DiyFp(f - rhs.f, e);	}
+
+    DiyFp
+    operator * (const DiyFp& rhs) const {
+#if defined(__SIZEOF_INT128__)
+        __uint128_t	p	= __uint128_t(f) * __uint128_t(rhs.f);
+        uint64_t	h	= uint64_t(p >> 64);
+        uint64_t	l	= uint64_t(p);
+        if( l & (uint64_t(1) << 63) )	// rounding
+            ++h;
+        return DiyFp(h, e + rhs.e + 64);
+#else
+        const uint64_t	M32	= 0xFFFFFFFFu;
+        uint64_t	a	= f >> 32;
+        uint64_t	b	= f & M32;
+        uint64_t	c	= rhs.f >> 32;
+        uint64_t	d	= rhs.f & M32;
+        uint64_t	ac	= a * c;
+        uint64_t	bc	= b * c;
+        uint64_t	ad	= a * d;
+        uint64_t	bd	= b * d;
+        uint64_t	tmp	= (bd >> 32) + (ad & M32) + (bc & M32);
+        tmp	+= 1u << 31;	// rounding
+        return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+#endif
+    }
+
+    DiyFp
+    normalize() const {
+        int	s	= __builtin_clzll(f);
+        return DiyFp(f << s, e - s);
+    }
+
+    DiyFp
+    normalizeBoundary() const {
+        DiyFp	res	= *this;
+        while( !(res.f & (HIDDEN_BIT << 1)) ) {
+            res.f	<<= 1;
+            --res.e;
+        }
+        res.f	<<= 64 - 52 - 2;
+        res.e	-= 64 - 52 - 2;
+        return res;
+    }
+
+    void
+    normalizedBoundaries(DiyFp* minus, DiyFp* plus) const {
+        DiyFp	pl	= DiyFp((f << 1) + 1, e - 1).normalizeBoundary();
+        DiyFp	mi	= (f == HIDDEN_BIT) ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+        mi.f	<<= mi.e - pl.e;
+        mi.e	= pl.e;
+        *plus	= pl;
+        *minus	= mi;
+    }
+
+    static const int		EXP_BIAS	= 0x3FF + 52;
+    static const uint64_t	EXP_MASK	= 0x7FF0000000000000ull;
+    static const uint64_t	FRAC_MASK	= 0x000FFFFFFFFFFFFFull;
+    static const uint64_t	HIDDEN_BIT	= 0x0010000000000000ull;
+
+    uint64_t	f;
+    int		e;
+};
+
+///
+/// cached power of ten c_k ~= 10^-k such that the product with a value of binary exponent e
+/// lands in the [-60, -32] exponent window digit generation expects
+///
+inline DiyFp
+getCachedPower(int e, int* k) {
+    // 10^-348, 10^-340, ..., 10^340
+    static const uint64_t	CACHED_F[87] = {
+        0xfa8fd5a0081c0288ull, 0xbaaee17fa23ebf76ull, 0x8b16fb203055ac76ull, 0xcf42894a5dce35eaull,
+        0x9a6bb0aa55653b2dull, 0xe61acf033d1a45dfull, 0xab70fe17c79ac6caull, 0xff77b1fcbebcdc4full,
+        0xbe5691ef416bd60cull, 0x8dd01fad907ffc3cull, 0xd3515c2831559a83ull, 0x9d71ac8fada6c9b5ull,
+        0xea9c227723ee8bcbull, 0xaecc49914078536dull, 0x823c12795db6ce57ull, 0xc21094364dfb5637ull,
+        0x9096ea6f3848984full, 0xd77485cb25823ac7ull, 0xa086cfcd97bf97f4ull, 0xef340a98172aace5ull,
+        0xb23867fb2a35b28eull, 0x84c8d4dfd2c63f3bull, 0xc5dd44271ad3cdbaull, 0x936b9fcebb25c996ull,
+        0xdbac6c247d62a584ull, 0xa3ab66580d5fdaf6ull, 0xf3e2f893dec3f126ull, 0xb5b5ada8aaff80b8ull,
+        0x87625f056c7c4a8bull, 0xc9bcff6034c13053ull, 0x964e858c91ba2655ull, 0xdff9772470297ebdull,
+        0xa6dfbd9fb8e5b88full, 0xf8a95fcf88747d94ull, 0xb94470938fa89bcfull, 0x8a08f0f8bf0f156bull,
+        0xcdb02555653131b6ull, 0x993fe2c6d07b7facull, 0xe45c10c42a2b3b06ull, 0xaa242499697392d3ull,
+        0xfd87b5f28300ca0eull, 0xbce5086492111aebull, 0x8cbccc096f5088ccull, 0xd1b71758e219652cull,
+        0x9c40000000000000ull, 0xe8d4a51000000000ull, 0xad78ebc5ac620000ull, 0x813f3978f8940984ull,
+        0xc097ce7bc90715b3ull, 0x8f7e32ce7bea5c70ull, 0xd5d238a4abe98068ull, 0x9f4f2726179a2245ull,
+        0xed63a231d4c4fb27ull, 0xb0de65388cc8ada8ull, 0x83c7088e1aab65dbull, 0xc45d1df942711d9aull,
+        0x924d692ca61be758ull, 0xda01ee641a708deaull, 0xa26da3999aef774aull, 0xf209787bb47d6b85ull,
+        0xb454e4a179dd1877ull, 0x865b86925b9bc5c2ull, 0xc83553c5c8965d3dull, 0x952ab45cfa97a0b3ull,
+        0xde469fbd99a05fe3ull, 0xa59bc234db398c25ull, 0xf6c69a72a3989f5cull, 0xb7dcbf5354e9beceull,
+        0x88fcf317f22241e2ull, 0xcc20ce9bd35c78a5ull, 0x98165af37b2153dfull, 0xe2a0b5dc971f303aull,
+        0xa8d9d1535ce3b396ull, 0xfb9b7cd9a4a7443cull, 0xbb764c4ca7a44410ull, 0x8bab8eefb6409c1aull,
+        0xd01fef10a657842cull, 0x9b10a4e5e9913129ull, 0xe7109bfba19c0c9dull, 0xac2820d9623bf429ull,
+        0x80444b5e7aa7cf85ull, 0xbf21e44003acdd2dull, 0x8e679c2f5e44ff8full, 0xd433179d9c8cb841ull,
+        0x9e19db92b4e31ba9ull, 0xeb96bf6ebadf77d9ull, 0xaf87023b9bf0ee6bull
+    };
+    static const int16_t	CACHED_E[87] = {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980, -954, -927,
+        -901, -874, -847, -821, -794, -768, -741, -715, -688, -661, -635, -608,
+        -582, -555, -529, -502, -475, -449, -422, -396, -369, -343, -316, -289,
+        -263, -236, -210, -183, -157, -130, -103, -77, -50, -24, 3, 30,
+        56, 83, 109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+        375, 402, 428, 455, 481, 508, 534, 561, 588, 614, 641, 667,
+        694, 720, 747, 774, 800, 827, 853, 880, 907, 933, 960, 986,
+        1013, 1039, 1066
+    };
+
+    double	dk	= (-61 - e) * 0.30102999566398114 + 347;	// dk must be positive, so can do ceiling in positive
+    int		ik	= int(dk);
+    if( dk - ik > 0.0 )
+        ++ik;
+
+    unsigned	index	= unsigned((ik >> 3) + 1);
+    *k	= -(-348 + int(index << 3));	// decimal exponent no need lookup table
+    return DiyFp(CACHED_F[index], CACHED_E[index]);
+}
+
+static const uint32_t	POW10_32[10] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000
+};
+
+static const uint64_t	POW10_64[20] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+inline void
+grisuRound(char* buffer, int len, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t wpW) {
+    while( rest < wpW && delta - rest >= tenKappa
+            && (rest + tenKappa < wpW || wpW - rest > rest + tenKappa - wpW) ) {
+        buffer[len - 1]--;
+        rest	+= tenKappa;
+    }
+}
+
+inline void
+digitGen(const DiyFp& W, const DiyFp& Mp, uint64_t delta, char* buffer, int* len, int* K) {
+    const DiyFp	one(uint64_t(1) << -Mp.e, Mp.e);
+    const DiyFp	wpW	= Mp - W;
+    uint32_t	p1	= uint32_t(Mp.f >> -one.e);
+    uint64_t	p2	= Mp.f & (one.f - 1);
+    int		kappa	= p1 ? int(countDigits(p1)) : 1;
+    *len	= 0;
+
+    while( kappa > 0 ) {
+        uint32_t	div	= POW10_32[kappa - 1];
+        uint32_t	d	= p1 / div;
+        p1	%= div;
+        if( d || *len )
+            buffer[(*len)++]	= char('0' + d);
+        --kappa;
+        uint64_t	tmp	= (uint64_t(p1) << -one.e) + p2;
+        if( tmp <= delta ) {
+            *K	+= kappa;
+            grisuRound(buffer, *len, delta, tmp, uint64_t(POW10_32[kappa]) << -one.e, wpW.f);
+            return;
+        }
+    }
+
+    // kappa = 0
+    for( ;; ) {
+        p2	*= 10;
+        delta	*= 10;
+        char	d	= char(p2 >> -one.e);
+        if( d || *len )
+            buffer[(*len)++]	= char('0' + d);
+        p2	&= one.f - 1;
+        --kappa;
+        if( p2 < delta ) {
+            *K	+= kappa;
+            int	index	= -kappa;
+            grisuRound(buffer, *len, delta, p2, one.f, wpW.f * (index < 20 ? POW10_64[index] : 0));
+            return;
+        }
+    }
+}
+
+///
+/// digits of v > 0 that round-trip, v = digits * 10^K. usually the shortest such
+/// digits, Grisu2 can emit one or two more at the edges of the rounding interval
+///
+inline void
+grisu2(double value, char* buffer, int* length, int* K) {
+    const DiyFp	v(value);
+    DiyFp	wM, wP;
+    v.normalizedBoundaries(&wM, &wP);
+
+    const DiyFp	cMk	= getCachedPower(wP.e, K);
+    const DiyFp	W	= v.normalize() * cMk;
+    DiyFp	Wp	= wP * cMk;
+    DiyFp	Wm	= wM * cMk;
+    ++Wm.f;
+    --Wp.f;
+    digitGen(W, Wp, Wp.f - Wm.f, buffer, length, K);
+}
+
+inline char*
+writeExponent(int k, char* buffer) {
+    if( k < 0 ) {
+        *buffer++	= '-';
+        k	= -k;
+    }
+
+    if( k >= 100 ) {
+        *buffer++	= char('0' + k / 100);
+        k	%= 100;
+        memcpy(buffer, DIGIT_PAIRS + k * 2, 2);
+        buffer	+= 2;
+    } else if( k >= 10 ) {
+        memcpy(buffer, DIGIT_PAIRS + k * 2, 2);
+        buffer	+= 2;
+    } else {
+        *buffer++	= char('0' + k);
+    }
+    return buffer;
+}
+
+///
+/// lay out length digits scaled by 10^k in the notation a reader expects:
+/// plain for 1e-6 <= v < 1e21, scientific otherwise
+///
+inline size_t
+prettify(char* buffer, int length, int k) {
+    const int	kk	= length + k;	// 10^(kk-1) <= v < 10^kk
+
+    if( length <= kk && kk <= 21 ) {
+        // 1234e7 -> 12340000000
+        for( int i = length; i < kk; ++i )
+            buffer[i]	= '0';
+        return size_t(kk);
+    } else if( 0 < kk && kk <= 21 ) {
+        // 1234e-2 -> 12.34
+        memmove(&buffer[kk + 1], &buffer[kk], size_t(length - kk));
+        buffer[kk]	= '.';
+        return size_t(length + 1);
+    } else if( -6 < kk && kk <= 0 ) {
+        // 1234e-6 -> 0.001234
+        const int	offset	= 2 - kk;
+        memmove(&buffer[offset], &buffer[0], size_t(length));
+        buffer[0]	= '0';
+        buffer[1]	= '.';
+        for( int i = 2; i < offset; ++i )
+            buffer[i]	= '0';
+        return size_t(length + offset);
+    } else if( length == 1 ) {
+        // 1e30
+        buffer[1]	= 'e';
+        return size_t(writeExponent(kk - 1, &buffer[2]) - buffer);
+    } else {
+        // 1234e30 -> 1.234e33
+        memmove(&buffer[2], &buffer[1], size_t(length - 1));
+        buffer[1]		= '.';
+        buffer[length + 1]	= 'e';
+        return size_t(writeExponent(kk - 1, &buffer[length + 2]) - buffer);
+    }
+}
+
+}	// namespace Detail
+
+///
+/// write the decimal representation of v, no terminating '\0'
+/// @param buf at least MAX_INT_CHARS bytes
+/// @param v the value
+/// @return the number of bytes written
+///
+inline size_t
+formatUInt(char* buf, uint64_t v) {
+    if( v < 10 ) {
+        *buf	= char('0' + v);
+        return 1;
+    }
+
+    unsigned	n	= Detail::countDigits(v);
+    Detail::writeDigits(buf, v, n);
+    return n;
+}
+
+inline size_t
+formatInt(char* buf, int64_t v) {
+    if( v < 0 ) {
+        *buf	= '-';
+        return 1 + formatUInt(buf + 1, 0 - uint64_t(v));
+    }
+    return formatUInt(buf, uint64_t(v));
+}
+
+///
+/// write a decimal representation that round-trips (parses back to exactly v), no
+/// terminating '\0'. it is the shortest one for nearly all values, see grisu2()
+/// @param buf at least MAX_DOUBLE_CHARS bytes
+/// @param v the value
+/// @return the number of bytes written
+///
+inline size_t
+formatDouble(char* buf, double v) {
+    uint64_t	bits;
+    memcpy(&bits, &v, sizeof(bits));
+
+    size_t	n	= 0;
+    if( bits >> 63 ) {
+        buf[n++]	= '-';
+        bits	&= ~(uint64_t(1) << 63);
+        memcpy(&v, &bits, sizeof(bits));
+    }
+
+    if( (bits & Detail::DiyFp::EXP_MASK) == Detail::DiyFp::EXP_MASK ) {
+        if( bits & Detail::DiyFp::FRAC_MASK ) {
+            memcpy(buf, "nan", 3);	// no sign for nan
+            return 3;
+        }
+        memcpy(buf + n, "inf", 3);
+        return n + 3;
+    }
+
+    if( bits == 0 ) {
+        buf[n]	= '0';
+        return n + 1;
+    }
+
+    int	length, k;
+    Detail::grisu2(v, buf + n, &length, &k);
+    return n + Detail::prettify(buf + n, length, k);
+}
+
+///
+/// parse an unsigned decimal integer spanning all of s[0, len)
+/// @param out receives the value on success
+/// @return false on empty input, stray characters or overflow
+///
+inline bool
+parseUInt(const char* s, size_t len, uint64_t& out) {
+    if( len == 0 )
+        return false;
+
+    uint64_t	v	= 0;
+    for( size_t i = 0; i < len; ++i ) {
+        unsigned	d	= unsigned(s[i] - '0');
+        if( d > 9 )
+            return false;
+        if( v > (UINT64_MAX - d) / 10 )
+            return false;
+        v	= v * 10 + d;
+    }
+    out	= v;
+    return true;
+}
+
+///
+/// parse an optionally signed decimal integer spanning all of s[0, len)
+/// @param out receives the value on success
+/// @return false on empty input, stray characters or overflow
+///
+inline bool
+parseInt(const char* s, size_t len, int64_t& out) {
+    bool	neg	= false;
+    if( len && (s[0] == '-' || s[0] == '+') ) {
+        neg	= s[0] == '-';
+        ++s;
+        --len;
+    }
+
+    uint64_t	u;
+    if( !parseUInt(s, len, u) )
+        return false;
+
+    if( neg ) {
+        if( u > uint64_t(INT64_MAX) + 1 )
+            return false;
+        out	= int64_t(0 - u);
+    } else {
+        if( u > uint64_t(INT64_MAX) )
+            return false;
+        out	= int64_t(u);
+    }
+    return true;
+}
+
+///
+/// parse a decimal floating point number spanning all of s[0, len).
+///
+/// numbers with at most 19 significant digits whose value is exactly representable
+/// with a single multiplication or division by a power of ten (Clinger's fast path)
+/// are converted inline; anything else (long mantissas, huge exponents, inf, nan)
+/// is handed to strtod so the result is always correctly rounded. strtod needs a
+/// terminated copy, kept on the stack below 64 bytes and malloc'd above, and reads
+/// the decimal point of the current C locale, so a program that switches LC_NUMERIC
+/// to a ',' locale gets false for the slow path inputs that contain a '.'.
+/// @param out receives the value on success
+/// @return false if s is not a number
+///
+inline bool
+parseDouble(const char* s, size_t len, double& out) {
+    static const double	EXACT_POW10[23] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    size_t	i	= 0;
+    bool	neg	= false;
+    if( i < len && (s[i] == '-' || s[i] == '+') ) {
+        neg	= s[i] == '-';
+        ++i;
+    }
+
+    uint64_t	mant		= 0;
+    int		digits		= 0;	// significant digits in mant
+    int		exp10		= 0;
+    bool	truncated	= false;
+    bool	any		= false;
+
+    for( ; i < len && unsigned(s[i] - '0') <= 9; ++i ) {
+        unsigned	d	= unsigned(s[i] - '0');
+        any	= true;
+        if( digits < 19 ) {
+            mant	= mant * 10 + d;
+            digits	+= mant != 0;
+        } else {
+            ++exp10;
+            truncated	|= d != 0;
+        }
+    }
+
+    if( i < len && s[i] == '.' ) {
+        for( ++i; i < len && unsigned(s[i] - '0') <= 9; ++i ) {
+            unsigned	d	= unsigned(s[i] - '0');
+            any	= true;
+            if( digits < 19 ) {
+                mant	= mant * 10 + d;
+                digits	+= mant != 0;
+                --exp10;
+            } else {
+                truncated	|= d != 0;
+            }
+        }
+    }
+
+    if( any && i < len && (s[i] == 'e' || s[i] == 'E') ) {
+        ++i;
+        bool	eneg	= false;
+        if( i < len && (s[i] == '-' || s[i] == '+') ) {
+            eneg	= s[i] == '-';
+            ++i;
+        }
+
+        if( i == len || unsigned(s[i] - '0') > 9 )
+            return false;
+
+        int	e	= 0;
+        for( ; i < len && unsigned(s[i] - '0') <= 9; ++i ) {
+            if( e < 100000 )
+                e	= e * 10 + (s[i] - '0');
+        }
+        exp10	+= eneg ? -e : e;
+    }
+
+    if( any ) {
+        if( i != len )
+            return false;
+
+        if( mant == 0 ) {
+            out	= neg ? -0.0 : 0.0;
+            return true;
+        }
+
+        if( !truncated && mant <= (uint64_t(1) << 53) && exp10 >= -22 && exp10 <= 22 ) {
+            double	d	= double(mant);
+            d	= exp10 < 0 ? d / EXACT_POW10[-exp10] : d * EXACT_POW10[exp10];
+            out	= neg ? -d : d;
+            return true;
+        }
+    } else if( i == len || (s[i] != 'i' && s[i] != 'I' && s[i] != 'n' && s[i] != 'N') ) {
+        // only inf and nan spellings are left for strtod
+        return false;
+    }
+
+    // slow path
+    char	stackBuf[64];
+    char*	buf	= len < sizeof(stackBuf) ? stackBuf : static_cast<char*>(malloc(len + 1));
+    if( !buf )
+        return false;
+    memcpy(buf, s, len);
+    buf[len]	= '\0';
+
+    char*	end	= nullptr;
+    double	d	= strtod(buf, &end);
+    bool	ok	= end == buf + len;
+    if( buf != stackBuf )
+        free(buf);
+
+    if( ok )
+        out	= d;
+    return ok;
+}
+
+}	// namespace BmCpp
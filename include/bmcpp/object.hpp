@@ -8,19 +8,217 @@
 
 namespace BmCpp {
 
-struct Object : public BaseAllocation {
-    inline virtual      ~Object()               {}
+///
+/// what dropping a strong reference requires from the object
+///
+enum RefRelease
+{
+    REF_KEEP,		///< other strong references remain
+    REF_DELETE,		///< last reference of any kind: destroy and free
+    REF_DESTROY		///< last strong reference but weak ones remain: destroy, keep the storage
+};
+
+///
+/// reference counter shared between threads. one 64 bit word holds the strong count
+/// (low half) and the weak count (high half); the strong owners collectively hold one
+/// weak reference, so the storage goes away when the weak count reaches zero.
+/// taking a reference only needs atomicity, dropping one must also order the owner's
+/// writes before the destruction (acq_rel)
+///
+struct AtomicRefCount {
+    AtomicRefCount() : count_(WEAK_ONE)	{}
+
+    ///
+    /// the strong half must not wrap, it would carry into the weak count
+    ///
+    inline void
+    increment() {
+        uint64_t	old	= count_.fetch_add(1, std::memory_order_relaxed);
+        assert((old & STRONG_MASK) != STRONG_MASK && "strong reference count overflow");
+        (void)old;
+    }
+
+    inline RefRelease
+    decrement() {
+        uint64_t	old	= count_.fetch_sub(1, std::memory_order_acq_rel);
+        if( (old & STRONG_MASK) != 1 )
+            return REF_KEEP;
+        return (old >> 32) == 1 ? REF_DELETE : REF_DESTROY;
+    }
+
+    /// @return false if the object is already dead
+    inline bool
+    tryIncrement() {
+        uint64_t	v	= count_.load(std::memory_order_relaxed);
+        do {
+            if( (v & STRONG_MASK) == 0 )
+                return false;
+            assert((v & STRONG_MASK) != STRONG_MASK && "strong reference count overflow");
+        } while( !count_.compare_exchange_weak(v, v + 1, std::memory_order_acquire, std::memory_order_relaxed) );
+        return true;
+    }
+
+    inline void		incrementWeak()		{ count_.fetch_add(WEAK_ONE, std::memory_order_relaxed); }
+    /// @return true if the storage must be freed
+    inline bool		decrementWeak()		{ return count_.fetch_sub(WEAK_ONE, std::memory_order_acq_rel) == WEAK_ONE; }
+
+    inline size_t	get() const		{ return size_t(count_.load(std::memory_order_relaxed) & STRONG_MASK); }
+
+private:
+    static const uint64_t	STRONG_MASK	= 0xffffffffull;
+    static const uint64_t	WEAK_ONE	= 0x100000000ull;
+
+    std::atomic<uint64_t>	count_;
+};
 
-    inline Object()     { count_.store(0); }
-    inline void         grab() const            { count_.fetch_add(1); }
-    inline void         release() const         { if( count_.fetch_sub(1) == 1 ) { delete const_cast<Object*>(this); } }
-    inline size_t		getRefCount() const     { return count_.load(); }
+///
+/// plain counter for objects that never leave the thread that created them,
+/// same layout as AtomicRefCount
+///
+struct LocalRefCount {
+    LocalRefCount() : strong_(0), weak_(1)	{}
+
+    inline void		increment()		{ assert(strong_ != 0xffffffffu && "strong reference count overflow"); ++strong_; }
+
+    inline RefRelease
+    decrement() {
+        if( --strong_ != 0 )
+            return REF_KEEP;
+        return weak_ == 1 ? REF_DELETE : REF_DESTROY;
+    }
+
+    inline bool
+    tryIncrement() {
+        if( strong_ == 0 )
+            return false;
+        increment();
+        return true;
+    }
+
+    inline void		incrementWeak()		{ ++weak_; }
+    inline bool		decrementWeak()		{ return --weak_ == 0; }
+    inline size_t	get() const		{ return strong_; }
+
+private:
+    uint32_t		strong_;
+    uint32_t		weak_;
+};
+
+namespace Detail {
+
+///
+/// a pointer the optimizer cannot trace back to an object whose lifetime ended,
+/// standing in for C++17 std::launder
+///
+template<typename T>
+inline T*
+launder(T* p) {
+    __asm__ volatile("" : "+r"(p) : : "memory");
+    return p;
+}
+
+}	// namespace Detail
+
+///
+/// intrusive reference counted base, the counter policy is picked at compile time.
+/// derive from Object (atomic) or LocalObject (single thread) rather than from this.
+///
+/// when the last strong reference goes while WeakObjectPtrs remain, the object is
+/// destroyed at once but its storage lives on until the last weak reference is gone.
+/// the counter is an object of its own, placed in a byte buffer of the base and never
+/// destroyed, so it outlives the destructor. the function freeing the storage is read
+/// from deallocator() before destruction and placed over the dead vtable pointer,
+/// which is why that path needs the counted base to start the allocation (always true
+/// with single inheritance). past the destructor only that raw storage is touched
+///
+template<typename Counter>
+struct ObjectBase : public BaseAllocation {
+    typedef void	(*Deallocator)(void* storage);
+    typedef Counter	CounterType;
+
+    inline virtual      ~ObjectBase()           {}
+
+    inline ObjectBase()	{ ::new(countStorage_) Counter(); }
+    inline void         grab() const            { counter().increment(); }
+    inline size_t		getRefCount() const     { return counter().get(); }
+
+    inline void
+    release() const {
+        switch( counter().decrement() ) {
+        case REF_KEEP:		break;
+        case REF_DELETE:	delete const_cast<ObjectBase*>(this); break;
+        case REF_DESTROY:	const_cast<ObjectBase*>(this)->destroyKeepStorage(); break;
+        }
+    }
+
+    ///
+    /// take a weak reference on a live object
+    /// @return the counter, valid until the matching releaseWeak() even once the object is gone
+    ///
+    inline Counter*
+    grabWeak() const {
+        counter().incrementWeak();
+        return &counter();
+    }
+
+    ///
+    /// drop a weak reference, freeing the storage if it was the last reference of any
+    /// kind. static because the object may be destroyed already
+    /// @param storage the start of the allocation
+    /// @param count what grabWeak() returned
+    ///
+    static void
+    releaseWeak(void* storage, Counter* count) {
+        if( count->decrementWeak() ) {
+            Deallocator	dealloc	= *Detail::launder(static_cast<Deallocator*>(storage));
+            dealloc(storage);
+        }
+    }
 
 protected:
-    inline Object(const Object& /*other*/) { count_.store(0); }
+    inline ObjectBase(const ObjectBase& /*other*/)	{ ::new(countStorage_) Counter(); }
+
+    ///
+    /// how the storage of a destroyed object is freed, override together with operator delete
+    ///
+    virtual Deallocator	deallocator() const	{ return &freeStorage; }
 
 private:
-    mutable     std::atomic<size_t> count_;
+    ObjectBase&	operator = (const ObjectBase&);	// the count belongs to the instance
+
+    static void		freeStorage(void* storage)	{ BaseAllocation::operator delete(storage); }
+
+    void
+    destroyKeepStorage() {
+        void*	storage	= dynamic_cast<void*>(this);
+        assert(storage == static_cast<void*>(this) && "weak references need the counted base first");
+        Deallocator	dealloc	= deallocator();
+        Counter*	count	= &counter();
+
+        this->~ObjectBase();
+        ::new(storage) Deallocator(dealloc);	// the vtable pointer is dead now
+
+        // drop the weak reference the strong owners held
+        releaseWeak(storage, Detail::launder(count));
+    }
+
+    Counter&	counter() const	{ return *reinterpret_cast<Counter*>(countStorage_); }
+
+    alignas(Counter) mutable unsigned char	countStorage_[sizeof(Counter)];
+};
+
+struct Object : public ObjectBase<AtomicRefCount> {
+    inline Object()	{}
+
+protected:
+    inline Object(const Object& other) : ObjectBase<AtomicRefCount>(other)	{}
+};
+
+struct LocalObject : public ObjectBase<LocalRefCount> {
+    inline LocalObject()	{}
+
+protected:
+    inline LocalObject(const LocalObject& other) : ObjectBase<LocalRefCount>(other)	{}
 };
 
 //
@@ -82,16 +280,40 @@ public:
 
     // Move support
 
-    //	ObjectPtr(ObjectPtr && rhs): px( rhs.px )
-    //	{
-    //		rhs.px = 0;
-    //	}
+    ObjectPtr(ObjectPtr && rhs): px( rhs.px ) {
+        rhs.px = 0;
+    }
 
-    //	ObjectPtr & operator=(ObjectPtr && rhs)
-    //	{
-    //		ThisType( static_cast< ObjectPtr && >( rhs ) ).swap(*this);
-    //		return *this;
-    //	}
+    template<class U>
+    ObjectPtr(ObjectPtr<U> && rhs): px( rhs.detach() ) {
+    }
+
+    ObjectPtr & operator=(ObjectPtr && rhs) {
+        ThisType( static_cast< ObjectPtr && >( rhs ) ).swap(*this);
+        return *this;
+    }
+
+    template<class U> ObjectPtr & operator=(ObjectPtr<U> && rhs) {
+        ThisType( static_cast< ObjectPtr<U> && >( rhs ) ).swap(*this);
+        return *this;
+    }
+
+    ///
+    /// take over a reference the caller already owns (no grab)
+    ///
+    static ObjectPtr adopt(T * p) {
+        return ObjectPtr(p, false);
+    }
+
+    ///
+    /// give up ownership without releasing, the caller now owns the reference
+    /// @return the pointer, to be handed to adopt() or released by hand
+    ///
+    T * detach() {
+        T * p = px;
+        px = 0;
+        return p;
+    }
 
     ObjectPtr & operator=(ObjectPtr const & rhs) {
         ThisType(rhs).swap(*this);
@@ -231,6 +453,85 @@ ObjectPtr<T> dynamic_pointer_cast(ObjectPtr<U> const & p) {
     return dynamic_cast<T *>(p.get());
 }
 
+///
+/// non-owning reference to an Object. it keeps the storage (not the object) around,
+/// so lock() can check the strong count and upgrade in a single CAS. next to the
+/// object pointer it holds the counter, the only part of a dead object it touches
+///
+template<class T>
+class WeakObjectPtr
+{
+    typedef typename T::CounterType	Counter;
+
+public:
+    WeakObjectPtr() : px(0), count(0)	{}
+
+    WeakObjectPtr(const ObjectPtr<T>& rhs) : px(rhs.get()), count(0) {
+        if( px != 0 ) {
+            assert(dynamic_cast<void*>(px) == static_cast<void*>(px) && "weak references need the counted base first");
+            count	= px->grabWeak();
+        }
+    }
+
+    WeakObjectPtr(const WeakObjectPtr& rhs) : px(rhs.px), count(rhs.count) {
+        if( count != 0 ) count->incrementWeak();
+    }
+
+    WeakObjectPtr(WeakObjectPtr&& rhs) : px(rhs.px), count(rhs.count) {
+        rhs.px		= 0;
+        rhs.count	= 0;
+    }
+
+    ~WeakObjectPtr() {
+        if( count != 0 ) T::releaseWeak(static_cast<void*>(px), count);
+    }
+
+    WeakObjectPtr& operator=(const WeakObjectPtr& rhs) {
+        WeakObjectPtr(rhs).swap(*this);
+        return *this;
+    }
+
+    WeakObjectPtr& operator=(WeakObjectPtr&& rhs) {
+        WeakObjectPtr(static_cast<WeakObjectPtr&&>(rhs)).swap(*this);
+        return *this;
+    }
+
+    WeakObjectPtr& operator=(const ObjectPtr<T>& rhs) {
+        WeakObjectPtr(rhs).swap(*this);
+        return *this;
+    }
+
+    ///
+    /// @return a strong reference, or a null one if the object is gone
+    ///
+    ObjectPtr<T> lock() const {
+        if( count != 0 && count->tryIncrement() )
+            return ObjectPtr<T>::adopt(px);
+        return ObjectPtr<T>();
+    }
+
+    bool expired() const {
+        return count == 0 || count->get() == 0;
+    }
+
+    void reset() {
+        WeakObjectPtr().swap(*this);
+    }
+
+    void swap(WeakObjectPtr& rhs) {
+        T *		tmp	= px;
+        Counter*	c	= count;
+        px		= rhs.px;
+        count		= rhs.count;
+        rhs.px		= tmp;
+        rhs.count	= c;
+    }
+
+private:
+    T*		px;
+    Counter*	count;
+};
+
 
 //
 //  Copyright (c) 2001, 2002 Peter Dimov
@@ -263,6 +564,8 @@ public:
     ConstObjectPtr(T* t): px( t )		{ if( px != 0 ) px->grab();	}
     ConstObjectPtr(const ConstObjectPtr& rhs): px( rhs.px )	{ if( px != 0 ) px->grab();	}
     ConstObjectPtr(ObjectPtr<T>& rhs)	: px(rhs.px)		{ if( px != 0 ) px->grab();	}
+    ConstObjectPtr(ConstObjectPtr&& rhs): px( rhs.px )		{ rhs.px = 0;	}
+    ConstObjectPtr(ObjectPtr<T>&& rhs)	: px(rhs.detach())	{}
 
     ~ConstObjectPtr()			{ if( px != 0 ) px->release();	}
 
@@ -276,6 +579,35 @@ public:
         return *this;
     }
 
+    ConstObjectPtr&			operator= (ConstObjectPtr&& rhs)	{
+        ThisType(static_cast<ConstObjectPtr&&>(rhs)).swap(*this);
+        return *this;
+    }
+
+    ConstObjectPtr&			operator= (ObjectPtr<T>&& rhs)	{
+        ThisType(static_cast<ObjectPtr<T>&&>(rhs)).swap(*this);
+        return *this;
+    }
+
+    ///
+    /// take over a reference the caller already owns (no grab)
+    ///
+    static ConstObjectPtr		adopt(const T* p)	{
+        ConstObjectPtr	r;
+        r.px	= const_cast<T*>(p);
+        return r;
+    }
+
+    ///
+    /// give up ownership without releasing
+    /// @return the pointer, the caller now owns its reference
+    ///
+    const T*				detach()		{
+        T*	p	= px;
+        px	= 0;
+        return p;
+    }
+
     //
     //	this one is ambigous because the compiler can create an "ConstObjectPtr" from casting the previous one (copy constructor)
     //
@@ -0,0 +1,342 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "array.hpp"
+#include "hashmap.hpp"
+#include "sort.hpp"
+#include "threadpool.hpp"
+
+namespace BmCpp {
+
+///
+/// data parallel loops on a ThreadPool. a range is cut into chunks of `grain` elements
+/// (0 picks about eight chunks per worker); chunks are handed out by recursive halving
+/// so idle workers steal big pieces first, and the calling thread takes part until
+/// the whole range is done. Array chunks start on cache line boundaries so two
+/// workers never write the same line
+///
+namespace Detail {
+
+inline size_t
+chunkSize(const ThreadPool& pool, size_t n, size_t grain) {
+    if( grain )
+        return grain;
+    size_t	target	= pool.size() * 8;
+    size_t	g	= (n + target - 1) / target;
+    return g ? g : 1;
+}
+
+///
+/// chunk boundaries over [0, n) for elements starting at base, moved up to the next
+/// cache line boundary when the element size allows it
+///
+struct Chunks
+{
+    Chunks(const void* base, size_t elemSize, size_t n, size_t chunk)
+        : n(n), chunk(chunk), count((n + chunk - 1) / chunk), perLine(1), phase(0) {
+        if( elemSize < CACHE_LINE_SIZE && CACHE_LINE_SIZE % elemSize == 0 ) {
+            size_t	mis	= size_t(reinterpret_cast<uintptr_t>(base) % CACHE_LINE_SIZE);
+            if( mis % elemSize == 0 ) {
+                perLine	= CACHE_LINE_SIZE / elemSize;
+                phase	= ((CACHE_LINE_SIZE - mis) % CACHE_LINE_SIZE) / elemSize;
+            }
+        }
+    }
+
+    size_t
+    begin(size_t i) const {
+        if( i == 0 )
+            return 0;
+        size_t	idx	= i * chunk;
+        if( perLine > 1 ) {
+            if( idx <= phase )
+                idx	= phase;
+            else
+                idx	= phase + (idx - phase + perLine - 1) / perLine * perLine;
+        }
+        return idx < n ? idx : n;
+    }
+
+    size_t	end(size_t i) const	{ return i + 1 == count ? n : begin(i + 1); }
+
+    size_t		n;
+    size_t		chunk;
+    size_t		count;
+    size_t		perLine;
+    size_t		phase;	///< first element index on a line boundary
+};
+
+template<typename Body>
+void
+splitChunks(TaskGroup& group, size_t lo, size_t hi, const Body& body) {
+    while( hi - lo > 1 ) {
+        size_t	mid	= lo + (hi - lo) / 2;
+        group.spawn([&group, mid, hi, &body]() { splitChunks(group, mid, hi, body); });
+        hi	= mid;
+    }
+    body(lo);
+}
+
+///
+/// run body(i) for every chunk index i in [0, count)
+///
+template<typename Body>
+void
+forChunks(ThreadPool& pool, size_t count, const Body& body) {
+    if( count == 0 )
+        return;
+    if( count == 1 ) {
+        body(0);
+        return;
+    }
+    TaskGroup	group(pool);
+    splitChunks(group, 0, count, body);
+    group.wait();
+}
+
+///
+/// how many elements of a go before element k of the stable merge of a and b:
+/// ties take a first
+///
+template<typename T, typename Cmp>
+size_t
+coRank(size_t k, const T* a, size_t m, const T* b, size_t n, const Cmp& less) {
+    size_t	i	= k < m ? k : m;
+    size_t	j	= k - i;
+    size_t	iLow	= k > n ? k - n : 0;
+    size_t	jLow	= k > m ? k - m : 0;
+    for(;;) {
+        if( i > 0 && j < n && less(b[j], a[i - 1]) ) {
+            size_t	delta	= (i - iLow + 1) / 2;
+            jLow	= j;
+            i	-= delta;
+            j	+= delta;
+        } else if( j > 0 && i < m && !less(b[j - 1], a[i]) ) {
+            size_t	delta	= (j - jLow + 1) / 2;
+            iLow	= i;
+            i	+= delta;
+            j	-= delta;
+        } else {
+            return i;
+        }
+    }
+}
+
+template<typename Table, typename Fn>
+void
+foreachSlots(ThreadPool& pool, Table& table, const Fn& fn, size_t grain) {
+    size_t	n	= size_t(table.capacity());
+    size_t	chunk	= chunkSize(pool, n, grain);
+    forChunks(pool, (n + chunk - 1) / chunk, [&table, &fn, chunk, n](size_t i) {
+        size_t	lo	= i * chunk;
+        size_t	hi	= lo + chunk < n ? lo + chunk : n;
+        table.foreach(int(lo), int(hi), fn);
+    });
+}
+
+}	// namespace Detail
+
+///
+/// call body(lo, hi) on disjoint sub ranges covering [begin, end)
+/// @param grain elements per chunk, 0 for automatic
+///
+template<typename Body>
+void
+parallelFor(ThreadPool& pool, size_t begin, size_t end, const Body& body, size_t grain = 0) {
+    if( end <= begin )
+        return;
+    size_t	n	= end - begin;
+    size_t	chunk	= Detail::chunkSize(pool, n, grain);
+    Detail::forChunks(pool, (n + chunk - 1) / chunk, [begin, end, chunk, &body](size_t i) {
+        size_t	lo	= begin + i * chunk;
+        size_t	hi	= end - lo > chunk ? lo + chunk : end;
+        body(lo, hi);
+    });
+}
+
+///
+/// reduce [begin, end): every chunk computes map(lo, hi), the chunk results are folded
+/// left to right with combine, so the result is deterministic for a given grain
+/// @return combine(...combine(identity, r0)..., rN)
+///
+template<typename R, typename Map, typename Combine>
+R
+parallelReduce(ThreadPool& pool, size_t begin, size_t end, const R& identity,
+               const Map& map, const Combine& combine, size_t grain = 0) {
+    if( end <= begin )
+        return identity;
+    size_t	n	= end - begin;
+    size_t	chunk	= Detail::chunkSize(pool, n, grain);
+    size_t	count	= (n + chunk - 1) / chunk;
+
+    // one result per cache line
+    struct Partial
+    {
+        R	value;
+        char	pad[CACHE_LINE_SIZE];
+    };
+    Array<Partial>	partials;
+    partials.resize(count);
+
+    Detail::forChunks(pool, count, [begin, end, chunk, &map, &partials](size_t i) {
+        size_t	lo	= begin + i * chunk;
+        size_t	hi	= end - lo > chunk ? lo + chunk : end;
+        partials[i].value	= map(lo, hi);
+    });
+
+    R	result	= identity;
+    for( size_t i = 0; i < count; ++i )
+        result	= combine(result, partials[i].value);
+    return result;
+}
+
+///
+/// fold every element of a: each chunk starts from identity and applies fold(acc, elem),
+/// the chunk results are then merged with combine
+///
+template<typename T, typename R, typename Fold, typename Combine>
+R
+parallelReduce(ThreadPool& pool, const Array<T>& a, const R& identity,
+               const Fold& fold, const Combine& combine, size_t grain = 0) {
+    return parallelReduce(pool, 0, a.size(), identity, [&a, &identity, &fold](size_t lo, size_t hi) {
+        R	acc	= identity;
+        for( size_t i = lo; i < hi; ++i )
+            acc	= fold(acc, a[i]);
+        return acc;
+    }, combine, grain);
+}
+
+///
+/// call fn(elem) on every element of a, in place
+///
+template<typename T, typename Fn>
+void
+parallelForeach(ThreadPool& pool, Array<T>& a, const Fn& fn, size_t grain = 0) {
+    Detail::Chunks	chunks(a.get(), sizeof(T), a.size(), Detail::chunkSize(pool, a.size(), grain));
+    Detail::forChunks(pool, chunks.count, [&a, &fn, &chunks](size_t i) {
+        for( size_t j = chunks.begin(i), e = chunks.end(i); j < e; ++j )
+            fn(a[j]);
+    });
+}
+
+///
+/// out[i] = fn(in[i]) for every element, out is resized to in.size()
+///
+template<typename T, typename U, typename Fn>
+void
+parallelTransform(ThreadPool& pool, const Array<T>& in, Array<U>& out, const Fn& fn, size_t grain = 0) {
+    out.resize(in.size());
+    Detail::Chunks	chunks(out.get(), sizeof(U), out.size(), Detail::chunkSize(pool, out.size(), grain));
+    Detail::forChunks(pool, chunks.count, [&in, &out, &fn, &chunks](size_t i) {
+        for( size_t j = chunks.begin(i), e = chunks.end(i); j < e; ++j )
+            out[j]	= fn(in[j]);
+    });
+}
+
+///
+/// HashTable / HashMap / HashSet versions walk disjoint slot ranges; fn takes the same
+/// arguments as the container's own foreach (for instance f(const K&, V*) for a map)
+/// @param grain slots per chunk, 0 for automatic
+///
+template<typename T, typename K, typename Traits, typename Fn>
+void
+parallelForeach(ThreadPool& pool, HashTable<T, K, Traits>& table, const Fn& fn, size_t grain = 0) {
+    Detail::foreachSlots(pool, table, fn, grain);
+}
+
+template<typename K, typename V, typename Fn>
+void
+parallelForeach(ThreadPool& pool, HashMap<K, V>& map, const Fn& fn, size_t grain = 0) {
+    Detail::foreachSlots(pool, map, fn, grain);
+}
+
+template<typename K, typename V, typename Fn>
+void
+parallelForeach(ThreadPool& pool, const HashMap<K, V>& map, const Fn& fn, size_t grain = 0) {
+    Detail::foreachSlots(pool, map, fn, grain);
+}
+
+template<typename T, typename Fn>
+void
+parallelForeach(ThreadPool& pool, const HashSet<T>& set, const Fn& fn, size_t grain = 0) {
+    Detail::foreachSlots(pool, set, fn, grain);
+}
+
+///
+/// merge sort for large arrays: chunks are sorted with sort() in parallel, then merged
+/// pairwise in log2(chunks) rounds. every round splits the output in chunk sized
+/// pieces (located by co-ranking both inputs) so even the last merge uses every worker.
+/// not stable; needs a scratch copy of the data, so T must be default constructible
+/// @param grain elements per chunk, 0 for automatic
+///
+template<typename T, typename Cmp>
+void
+parallelSort(ThreadPool& pool, Array<T>& a, const Cmp& less, size_t grain = 0) {
+    size_t	n	= a.size();
+    size_t	chunk	= Detail::chunkSize(pool, n, grain);
+    if( chunk < 4096 && grain == 0 )
+        chunk	= 4096;	// below that the merge overhead dominates
+    if( n <= chunk ) {
+        sort(a, less);
+        return;
+    }
+
+    size_t	count	= (n + chunk - 1) / chunk;
+    Detail::forChunks(pool, count, [&a, &less, chunk, n](size_t i) {
+        size_t	lo	= i * chunk;
+        size_t	hi	= n - lo > chunk ? lo + chunk : n;
+        sort(a.get() + lo, a.get() + hi, less);
+    });
+
+    Array<T>	scratch;
+    scratch.resize(n);
+    Array<size_t>	splits;	///< per output chunk, how many of its elements come from the left run
+    splits.resize(count);
+    T*	src	= a.get();
+    T*	dst	= scratch.get();
+    for( size_t width = chunk; width < n; width *= 2 ) {
+        // every split of the round is found before any element is moved out of src
+        Detail::forChunks(pool, count, [src, &splits, &less, chunk, width, n](size_t s) {
+            size_t	lo	= s * chunk;
+            size_t	pair	= lo / (2 * width) * (2 * width);
+            size_t	mid	= n - pair > width ? pair + width : n;
+            size_t	hi	= n - pair > 2 * width ? pair + 2 * width : n;
+            splits[s]	= Detail::coRank(lo - pair, src + pair, mid - pair, src + mid, hi - mid, less);
+        });
+
+        Detail::forChunks(pool, count, [src, dst, &splits, &less, chunk, width, n](size_t s) {
+            size_t	lo	= s * chunk;
+            size_t	pair	= lo / (2 * width) * (2 * width);
+            size_t	mid	= n - pair > width ? pair + width : n;
+            size_t	hi	= n - pair > 2 * width ? pair + 2 * width : n;
+            size_t	end	= hi - lo > chunk ? lo + chunk : hi;
+
+            size_t	i	= splits[s];
+            size_t	j	= lo - pair - i;
+            size_t	iEnd	= end == hi ? mid - pair : splits[s + 1];	// the next chunk of the same pair starts at end
+            size_t	jEnd	= end - pair - iEnd;
+
+            T*	out	= dst + lo;
+            while( i < iEnd && j < jEnd )
+                *out++	= less(src[mid + j], src[pair + i]) ? move(src[mid + j++]) : move(src[pair + i++]);
+            while( i < iEnd )
+                *out++	= move(src[pair + i++]);
+            while( j < jEnd )
+                *out++	= move(src[mid + j++]);
+        });
+        T*	t	= src;
+        src	= dst;
+        dst	= t;
+    }
+
+    if( src != a.get() )
+        a	= move(scratch);
+}
+
+template<typename T>
+void
+parallelSort(ThreadPool& pool, Array<T>& a) {
+    parallelSort(pool, a, Less<T>());
+}
+
+}	// namespace BmCpp
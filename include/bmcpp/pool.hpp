@@ -0,0 +1,245 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "object.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+
+namespace BmCpp {
+
+struct PoolStats
+{
+    size_t		blocks;		///< blocks taken from malloc and not yet given back by trim()
+    size_t		depotFree;	///< free blocks in the shared depot, not counting thread caches
+    size_t		refills;	///< thread caches refilled from the depot
+    size_t		flushes;	///< thread caches spilled into the depot
+};
+
+///
+/// fixed size block recycler, one per type T. every thread keeps a small private
+/// free list; only refills and spills (a batch at a time) touch the shared depot,
+/// which is a spin-locked free list. blocks cached by a thread go back to the depot
+/// when the thread exits
+///
+template<typename T>
+struct ObjectPool
+{
+    enum
+    {
+        CACHE_MAX	= 64,	///< a thread cache holding more spills BATCH blocks
+        BATCH		= 32,
+        BLOCK_SIZE	= sizeof(T) > sizeof(void*) ? sizeof(T) : sizeof(void*)	///< room for a T or the free list link
+    };
+
+    static void*
+    allocate() {
+        Cache&	c	= cache;
+        if( !c.head ) {
+            if( !c.registered )
+                registerThread(c);
+            refill(c);
+        }
+
+        if( FreeBlock* b = c.head ) {
+            c.head	= b->next;
+            --c.count;
+            return b;
+        }
+
+        depot.blocks.fetch_add(1, std::memory_order_relaxed);
+        void*	p	= malloc(BLOCK_SIZE);
+        assert(p != nullptr);
+        return p;
+    }
+
+    ///
+    /// a block of len > BLOCK_SIZE bytes from malloc. it can go back through
+    /// deallocate() like any block: the pool reuses it as a BLOCK_SIZE one
+    ///
+    static void*
+    allocateLarge(size_t len) {
+        depot.blocks.fetch_add(1, std::memory_order_relaxed);
+        void*	p	= malloc(len);
+        assert(p != nullptr);
+        return p;
+    }
+
+    static void
+    deallocate(void* p) {
+        Cache&	c	= cache;
+        if( !c.registered )
+            registerThread(c);
+
+        FreeBlock*	b	= static_cast<FreeBlock*>(p);
+        b->next	= c.head;
+        c.head	= b;
+        if( ++c.count > CACHE_MAX )
+            spill(c, BATCH);
+    }
+
+    static PoolStats
+    stats() {
+        PoolStats	s;
+        lock();
+        s.blocks	= depot.blocks.load(std::memory_order_relaxed);
+        s.depotFree	= depot.count;
+        s.refills	= depot.refills;
+        s.flushes	= depot.flushes;
+        unlock();
+        return s;
+    }
+
+    ///
+    /// free every block sitting in the depot
+    ///
+    static void
+    trim() {
+        lock();
+        FreeBlock*	b	= depot.head;
+        depot.blocks.fetch_sub(depot.count, std::memory_order_relaxed);
+        depot.head	= nullptr;
+        depot.count	= 0;
+        unlock();
+
+        while( b ) {
+            FreeBlock*	next	= b->next;
+            free(b);
+            b	= next;
+        }
+    }
+
+private:
+    struct FreeBlock
+    {
+        FreeBlock*	next;
+    };
+
+    // both are constant initialized and trivially destructible, so neither needs
+    // runtime support for statics or thread locals
+    struct Cache
+    {
+        FreeBlock*	head;
+        size_t		count;
+        bool		registered;
+    };
+
+    struct Depot
+    {
+        std::atomic_flag	busy;
+        FreeBlock*		head;
+        size_t			count;
+        size_t			refills;
+        size_t			flushes;
+        std::atomic<size_t>	blocks;
+        pthread_once_t		keyOnce;
+        pthread_key_t		key;
+    };
+
+    static void
+    lock() {
+        while( depot.busy.test_and_set(std::memory_order_acquire) )
+            sched_yield();
+    }
+
+    static void	unlock()	{ depot.busy.clear(std::memory_order_release); }
+
+    static void
+    refill(Cache& c) {
+        lock();
+        if( depot.head ) {
+            FreeBlock*	first	= depot.head;
+            FreeBlock*	last	= first;
+            size_t		n	= 1;
+            while( n < BATCH && last->next ) {
+                last	= last->next;
+                ++n;
+            }
+            depot.head	= last->next;
+            depot.count	-= n;
+            ++depot.refills;
+
+            last->next	= c.head;
+            c.head		= first;
+            c.count		+= n;
+        }
+        unlock();
+    }
+
+    static void
+    spill(Cache& c, size_t n) {
+        if( n == 0 || !c.head )
+            return;
+
+        FreeBlock*	first	= c.head;
+        FreeBlock*	last	= first;
+        size_t		k	= 1;
+        while( k < n && last->next ) {
+            last	= last->next;
+            ++k;
+        }
+        c.head	= last->next;
+        c.count	-= k;
+
+        lock();
+        last->next	= depot.head;
+        depot.head	= first;
+        depot.count	+= k;
+        ++depot.flushes;
+        unlock();
+    }
+
+    static void	createKey()	{ pthread_key_create(&depot.key, &onThreadExit); }
+
+    static void
+    registerThread(Cache& c) {
+        pthread_once(&depot.keyOnce, &createKey);
+        pthread_setspecific(depot.key, &c);
+        c.registered	= true;
+    }
+
+    static void
+    onThreadExit(void* p) {
+        Cache*	c	= static_cast<Cache*>(p);
+        spill(*c, c->count);
+        c->registered	= false;
+    }
+
+    static thread_local Cache	cache;
+    static Depot			depot;
+};
+
+template<typename T>
+thread_local typename ObjectPool<T>::Cache	ObjectPool<T>::cache	= { nullptr, 0, false };
+
+template<typename T>
+typename ObjectPool<T>::Depot	ObjectPool<T>::depot	= { ATOMIC_FLAG_INIT, nullptr, 0, 0, 0, { 0 }, PTHREAD_ONCE_INIT, 0 };
+
+///
+/// opt-in recycling for Object derived classes: struct Message : PooledObject<Message> { ... }.
+/// new and delete (and the storage release of weakly referenced objects) go through
+/// ObjectPool<T> instead of malloc/free. T should be the most derived type: a class
+/// deriving from T does not fit a block, so it is allocated with malloc, and when it is
+/// freed the pool keeps it as one of its (smaller) blocks
+///
+template<typename T, typename Base = Object>
+struct PooledObject : public Base
+{
+    inline void*	operator new(size_t len) noexcept {
+        if( len > ObjectPool<T>::BLOCK_SIZE )
+            return ObjectPool<T>::allocateLarge(len);
+        return ObjectPool<T>::allocate();
+    }
+
+    inline void		operator delete(void* p) noexcept	{ ObjectPool<T>::deallocate(p); }
+
+    inline void*	operator new(size_t, void* p) noexcept	{ return p; }
+    inline void		operator delete(void*, void*) noexcept	{}
+
+    static PoolStats	poolStats()	{ return ObjectPool<T>::stats(); }
+
+protected:
+    typename Base::Deallocator	deallocator() const override	{ return &ObjectPool<T>::deallocate; }
+};
+
+}	// namespace BmCpp
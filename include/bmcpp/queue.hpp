@@ -0,0 +1,411 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "array.hpp"
+
+namespace BmCpp {
+
+///
+/// bounded single producer / single consumer ring, wait-free on both sides.
+/// each side keeps its own index on its own cache line plus a cached copy of the
+/// other side's index, so the shared lines are only touched when the cache says
+/// the ring looks full (producer) or empty (consumer)
+///
+template<typename T>
+struct SpscQueue : public BaseAllocation, private NonCopyable
+{
+    ///
+    /// @param capacity the minimum number of elements, rounded up to a power of two
+    ///
+    explicit SpscQueue(size_t capacity)
+        : capacity_(roundUp(capacity)), mask(capacity_ - 1), slots(nullptr)
+        , tail(0), cachedHead(0), head(0), cachedTail(0) {
+        slots	= static_cast<T*>(malloc(capacity_ * sizeof(T)));
+        assert(slots != nullptr);
+    }
+
+    ~SpscQueue() {
+        size_t	t	= tail.load(std::memory_order_relaxed);
+        for( size_t h = head.load(std::memory_order_relaxed); h != t; ++h )
+            slots[h & mask].~T();
+        free(slots);
+    }
+
+    ///
+    /// producer side
+    /// @return false if the ring is full
+    ///
+    bool
+    tryPush(const T& t) {
+        size_t	pos	= tail.load(std::memory_order_relaxed);
+        if( pos - cachedHead == capacity_ ) {
+            cachedHead	= head.load(std::memory_order_acquire);
+            if( pos - cachedHead == capacity_ )
+                return false;
+        }
+
+        new(&slots[pos & mask]) T(t);
+        tail.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    ///
+    /// consumer side
+    /// @param out receives the oldest element
+    /// @return false if the ring is empty
+    ///
+    bool
+    tryPop(T& out) {
+        size_t	pos	= head.load(std::memory_order_relaxed);
+        if( pos == cachedTail ) {
+            cachedTail	= tail.load(std::memory_order_acquire);
+            if( pos == cachedTail )
+                return false;
+        }
+
+        T&	slot	= slots[pos & mask];
+        out	= move(slot);
+        slot.~T();
+        head.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    ///
+    /// @return the number of queued elements, only exact when both sides are idle
+    ///
+    size_t
+    sizeApprox() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+
+    size_t		capacity() const	{ return capacity_;	}
+
+private:
+    static size_t
+    roundUp(size_t n) {
+        size_t	c	= 2;
+        while( c < n )
+            c	<<= 1;
+        return c;
+    }
+
+    const size_t		capacity_;
+    const size_t		mask;
+    T*			slots;
+    char			pad0[CACHE_LINE_SIZE];
+
+    std::atomic<size_t>	tail;		///< written by the producer
+    size_t			cachedHead;	///< producer's view of head
+    char			pad1[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+
+    std::atomic<size_t>	head;		///< written by the consumer
+    size_t			cachedTail;	///< consumer's view of tail
+    char			pad2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>) - sizeof(size_t)];
+};	// struct SpscQueue
+
+///
+/// link of an IntrusiveMpscQueue, embedded in the queued object
+///
+struct MpscHook
+{
+    MpscHook() : next(nullptr)	{}
+
+private:
+    std::atomic<MpscHook*>	next;
+
+    template<typename T, MpscHook T::*Hook>
+    friend struct IntrusiveMpscQueue;
+};
+
+///
+/// unbounded multi producer / single consumer queue threaded through an MpscHook member
+/// (Dmitry Vyukov's intrusive MPSC node queue). push is a single exchange and never
+/// waits, pop is wait-free but can transiently report empty while a producer is between
+/// its two steps. the queue never allocates and does not own the objects
+///
+template<typename T, MpscHook T::*Hook>
+struct IntrusiveMpscQueue : public BaseAllocation, private NonCopyable
+{
+    IntrusiveMpscQueue() : head(&stub), tail(&stub)	{}
+
+    ///
+    /// enqueue t, callable from any thread
+    ///
+    void
+    push(T& t) {
+        pushHook(&(t.*Hook));
+    }
+
+    ///
+    /// dequeue the oldest object, consumer thread only
+    /// @return the object or nullptr if the queue is (or looks) empty
+    ///
+    T*
+    pop() {
+        MpscHook*	t	= tail;
+        MpscHook*	next	= t->next.load(std::memory_order_acquire);
+
+        if( t == &stub ) {
+            if( !next )
+                return nullptr;
+            tail	= next;
+            t	= next;
+            next	= next->next.load(std::memory_order_acquire);
+        }
+
+        if( next ) {
+            tail	= next;
+            return fromHook(t);
+        }
+
+        if( t != head.load(std::memory_order_acquire) )
+            return nullptr;	// a producer swapped head but has not linked yet
+
+        // t is the last node: put the stub behind it so t can be handed out
+        pushHook(&stub);
+        next	= t->next.load(std::memory_order_acquire);
+        if( next ) {
+            tail	= next;
+            return fromHook(t);
+        }
+        return nullptr;
+    }
+
+    ///
+    /// @return true if nothing is queued, consumer thread only
+    ///
+    bool
+    empty() const {
+        return tail == &stub && !stub.next.load(std::memory_order_acquire);
+    }
+
+private:
+    void
+    pushHook(MpscHook* h) {
+        h->next.store(nullptr, std::memory_order_relaxed);
+        MpscHook*	prev	= head.exchange(h, std::memory_order_acq_rel);
+        prev->next.store(h, std::memory_order_release);
+    }
+
+    static T*
+    fromHook(MpscHook* h) {
+        const size_t	offset	= reinterpret_cast<size_t>(&(reinterpret_cast<T*>(size_t(0x1000))->*Hook)) - size_t(0x1000);
+        return reinterpret_cast<T*>(reinterpret_cast<char*>(h) - offset);
+    }
+
+    std::atomic<MpscHook*>	head;		///< last pushed, shared by the producers
+    char			pad0[CACHE_LINE_SIZE - sizeof(std::atomic<MpscHook*>)];
+    MpscHook*		tail;		///< next to pop, consumer only
+    MpscHook		stub;
+};	// struct IntrusiveMpscQueue
+
+///
+/// unbounded multi producer / single consumer queue of values (ObjectPtr, plain structs...),
+/// built on IntrusiveMpscQueue with one node allocation per push
+///
+template<typename T>
+struct MpscQueue : public BaseAllocation, private NonCopyable
+{
+    MpscQueue()	{}
+
+    ~MpscQueue() {
+        while( Node* n = queue.pop() )
+            delete n;
+    }
+
+    void
+    push(const T& t) {
+        queue.push(*(new Node(t)));
+    }
+
+    void
+    push(T&& t) {
+        queue.push(*(new Node(move(t))));
+    }
+
+    ///
+    /// consumer thread only
+    /// @param out receives the oldest value
+    /// @return false if the queue is (or looks) empty
+    ///
+    bool
+    tryPop(T& out) {
+        Node*	n	= queue.pop();
+        if( !n )
+            return false;
+        out	= move(n->value);
+        delete n;
+        return true;
+    }
+
+    bool	empty() const	{ return queue.empty();	}
+
+private:
+    struct Node : BaseAllocation
+    {
+        explicit Node(const T& t) : value(t)	{}
+        explicit Node(T&& t) : value(move(t))	{}
+        MpscHook	hook;
+        T		value;
+    };
+
+    IntrusiveMpscQueue<Node, &Node::hook>	queue;
+};	// struct MpscQueue
+
+///
+/// bounded multi producer / multi consumer ring (Dmitry Vyukov's sequenced slots).
+/// every slot carries a sequence number telling which lap of which side may use it
+/// next, so producers and consumers only contend on their own cursor. the batch calls
+/// claim a run of ready slots with a single CAS on that cursor
+///
+template<typename T>
+struct MpmcQueue : public BaseAllocation, private NonCopyable
+{
+    ///
+    /// @param capacity the minimum number of elements, rounded up to a power of two
+    ///
+    explicit MpmcQueue(size_t capacity) : slots(nullptr), mask(0), enqueuePos(0), dequeuePos(0) {
+        size_t	c	= 2;
+        while( c < capacity )
+            c	<<= 1;
+        mask	= c - 1;
+
+        // the ring never changes size, so the slots are laid out once and never move
+        slots	= static_cast<Slot*>(malloc(c * sizeof(Slot)));
+        assert(slots != nullptr && reinterpret_cast<uintptr_t>(slots) % alignof(Slot) == 0);
+        for( size_t i = 0; i < c; ++i )
+            new(&slots[i]) Slot(i);
+    }
+
+    ~MpmcQueue() {
+        size_t	d	= dequeuePos.load(std::memory_order_relaxed);
+        size_t	e	= enqueuePos.load(std::memory_order_relaxed);
+        for( ; d != e; ++d )
+            slots[d & mask].value()->~T();
+        for( size_t i = 0; i <= mask; ++i )
+            slots[i].~Slot();
+        free(slots);
+    }
+
+    ///
+    /// @return false if the ring is full
+    ///
+    bool
+    tryPush(const T& t) {
+        return tryPushBatch(&t, 1) == 1;
+    }
+
+    ///
+    /// @param out receives the oldest element
+    /// @return false if the ring is empty
+    ///
+    bool
+    tryPop(T& out) {
+        return tryPopBatch(&out, 1) == 1;
+    }
+
+    ///
+    /// enqueue up to n elements in order, claiming their slots with one CAS
+    /// @param items the elements to copy in
+    /// @param n the number of elements
+    /// @return the number of elements pushed (the leading part of items), 0 if full
+    ///
+    size_t
+    tryPushBatch(const T* items, size_t n) {
+        if( n == 0 )
+            return 0;
+        size_t	pos	= enqueuePos.load(std::memory_order_relaxed);
+        size_t	k;
+        for(;;) {
+            k	= readyRun(pos, n, 0);
+            if( k ) {
+                if( enqueuePos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed) )
+                    break;
+            } else {
+                intptr_t	dif	= intptr_t(slots[pos & mask].seq.load(std::memory_order_acquire)) - intptr_t(pos);
+                if( dif < 0 )
+                    return 0;	// the slot still holds last lap's element
+                pos	= enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        for( size_t i = 0; i < k; ++i ) {
+            Slot&	s	= slots[(pos + i) & mask];
+            new(s.value()) T(items[i]);
+            s.seq.store(pos + i + 1, std::memory_order_release);
+        }
+        return k;
+    }
+
+    ///
+    /// dequeue up to n elements in order, claiming their slots with one CAS
+    /// @param out receives the elements
+    /// @param n the room in out
+    /// @return the number of elements popped, 0 if empty
+    ///
+    size_t
+    tryPopBatch(T* out, size_t n) {
+        if( n == 0 )
+            return 0;
+        size_t	pos	= dequeuePos.load(std::memory_order_relaxed);
+        size_t	k;
+        for(;;) {
+            k	= readyRun(pos, n, 1);
+            if( k ) {
+                if( dequeuePos.compare_exchange_weak(pos, pos + k, std::memory_order_relaxed) )
+                    break;
+            } else {
+                intptr_t	dif	= intptr_t(slots[pos & mask].seq.load(std::memory_order_acquire)) - intptr_t(pos + 1);
+                if( dif < 0 )
+                    return 0;	// the producer of this slot has not published yet
+                pos	= dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+
+        for( size_t i = 0; i < k; ++i ) {
+            Slot&	s	= slots[(pos + i) & mask];
+            T*	v	= s.value();
+            out[i]	= move(*v);
+            v->~T();
+            s.seq.store(pos + i + mask + 1, std::memory_order_release);
+        }
+        return k;
+    }
+
+    size_t		capacity() const	{ return mask + 1;	}
+
+private:
+    struct Slot : private NonCopyable
+    {
+        explicit Slot(size_t seq) : seq(seq)	{}
+
+        T*		value()	{ return reinterpret_cast<T*>(storage);	}
+
+        std::atomic<size_t>	seq;
+        alignas(T) unsigned char	storage[sizeof(T)];
+    };
+
+    ///
+    /// count the slots from pos on whose sequence is pos + i + lag, i.e. ready for this side
+    ///
+    size_t
+    readyRun(size_t pos, size_t n, size_t lag) {
+        size_t	k	= 0;
+        while( k < n && k <= mask
+               && slots[(pos + k) & mask].seq.load(std::memory_order_acquire) == pos + k + lag )
+            ++k;
+        return k;
+    }
+
+    Slot*			slots;
+    size_t			mask;
+    char			pad0[CACHE_LINE_SIZE];
+
+    std::atomic<size_t>	enqueuePos;
+    char			pad1[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+
+    std::atomic<size_t>	dequeuePos;
+    char			pad2[CACHE_LINE_SIZE - sizeof(std::atomic<size_t>)];
+};	// struct MpmcQueue
+
+}	// namespace BmCpp
@@ -0,0 +1,325 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "array.hpp"
+
+#include <cstddef>
+#include <cstring>
+
+namespace BmCpp {
+
+namespace Detail {
+
+template<typename T>
+inline void
+swapValues(T& a, T& b) {
+    T	tmp(move(a));
+    a	= move(b);
+    b	= move(tmp);
+}
+
+template<typename T, typename Cmp>
+void
+insertionSort(T* first, T* last, const Cmp& less) {
+    if( last - first < 2 )
+        return;
+    for( T* i = first + 1; i < last; ++i ) {
+        T	tmp(move(*i));
+        T*	j	= i;
+        if( less(tmp, *first) ) {
+            // goes to the front, no need to compare on the way
+            for( ; j > first; --j )
+                *j	= move(*(j - 1));
+        } else {
+            for( ; less(tmp, *(j - 1)); --j )
+                *j	= move(*(j - 1));
+        }
+        *j	= move(tmp);
+    }
+}
+
+template<typename T, typename Cmp>
+void
+siftDown(T* heap, size_t i, size_t n, const Cmp& less) {
+    T	tmp(move(heap[i]));
+    for(;;) {
+        size_t	child	= 2 * i + 1;
+        if( child >= n )
+            break;
+        if( child + 1 < n && less(heap[child], heap[child + 1]) )
+            ++child;
+        if( !less(tmp, heap[child]) )
+            break;
+        heap[i]	= move(heap[child]);
+        i	= child;
+    }
+    heap[i]	= move(tmp);
+}
+
+template<typename T, typename Cmp>
+void
+heapSort(T* first, T* last, const Cmp& less) {
+    size_t	n	= size_t(last - first);
+    for( size_t i = n / 2; i-- > 0; )
+        siftDown(first, i, n, less);
+    while( n > 1 ) {
+        --n;
+        swapValues(first[0], first[n]);
+        siftDown(first, 0, n, less);
+    }
+}
+
+template<typename T, typename Cmp>
+void
+moveMedianToFirst(T* result, T* a, T* b, T* c, const Cmp& less) {
+    if( less(*a, *b) ) {
+        if( less(*b, *c) )	swapValues(*result, *b);
+        else if( less(*a, *c) )	swapValues(*result, *c);
+        else			swapValues(*result, *a);
+    } else if( less(*a, *c) )	swapValues(*result, *a);
+    else if( less(*b, *c) )	swapValues(*result, *c);
+    else			swapValues(*result, *b);
+}
+
+enum
+{
+    INSERTION_SORT_THRESHOLD	= 16
+};
+
+template<typename T, typename Cmp>
+void
+introSortLoop(T* first, T* last, size_t depth, const Cmp& less) {
+    while( last - first > INSERTION_SORT_THRESHOLD ) {
+        if( depth == 0 ) {
+            heapSort(first, last, less);
+            return;
+        }
+        --depth;
+
+        // median of three as the pivot; the other two then guard both scans
+        moveMedianToFirst(first, first + 1, first + (last - first) / 2, last - 1, less);
+        T*	lo	= first + 1;
+        T*	hi	= last;
+        for(;;) {
+            while( less(*lo, *first) )
+                ++lo;
+            --hi;
+            while( less(*first, *hi) )
+                --hi;
+            if( !(lo < hi) )
+                break;
+            swapValues(*lo, *hi);
+            ++lo;
+        }
+
+        introSortLoop(lo, last, depth, less);
+        last	= lo;
+    }
+    insertionSort(first, last, less);
+}
+
+///
+/// order preserving map of a key to an unsigned integer of the same width
+///
+template<typename K> struct RadixKey;
+
+template<> struct RadixKey<uint8_t>	{ typedef uint8_t	Bits;	static Bits get(uint8_t k)	{ return k; } };
+template<> struct RadixKey<uint16_t>	{ typedef uint16_t	Bits;	static Bits get(uint16_t k)	{ return k; } };
+template<> struct RadixKey<uint32_t>	{ typedef uint32_t	Bits;	static Bits get(uint32_t k)	{ return k; } };
+template<> struct RadixKey<uint64_t>	{ typedef uint64_t	Bits;	static Bits get(uint64_t k)	{ return k; } };
+template<> struct RadixKey<int8_t>	{ typedef uint8_t	Bits;	static Bits get(int8_t k)	{ return Bits(k) ^ 0x80u; } };
+template<> struct RadixKey<int16_t>	{ typedef uint16_t	Bits;	static Bits get(int16_t k)	{ return Bits(Bits(k) ^ 0x8000u); } };
+template<> struct RadixKey<int32_t>	{ typedef uint32_t	Bits;	static Bits get(int32_t k)	{ return Bits(k) ^ 0x80000000u; } };
+template<> struct RadixKey<int64_t>	{ typedef uint64_t	Bits;	static Bits get(int64_t k)	{ return Bits(k) ^ 0x8000000000000000ull; } };
+
+// IEEE floats: flip every bit of negatives, only the sign bit of positives
+template<> struct RadixKey<float> {
+    typedef uint32_t	Bits;
+    static Bits
+    get(float k) {
+        Bits	b;
+        memcpy(&b, &k, sizeof(b));
+        return (b & 0x80000000u) ? ~b : (b | 0x80000000u);
+    }
+};
+
+template<> struct RadixKey<double> {
+    typedef uint64_t	Bits;
+    static Bits
+    get(double k) {
+        Bits	b;
+        memcpy(&b, &k, sizeof(b));
+        return (b & 0x8000000000000000ull) ? ~b : (b | 0x8000000000000000ull);
+    }
+};
+
+template<typename T>
+struct IdentityKey {
+    const T&	operator()(const T& t) const	{ return t; }
+};
+
+}	// namespace Detail
+
+///
+/// in place introsort (quicksort with median of three, heapsort once the recursion
+/// gets too deep, insertion sort for small ranges). not stable
+///
+template<typename T, typename Cmp>
+void
+sort(T* first, T* last, const Cmp& less) {
+    size_t	n	= size_t(last - first);
+    size_t	depth	= 0;
+    for( size_t k = n; k > 1; k >>= 1 )
+        depth	+= 2;
+    Detail::introSortLoop(first, last, depth, less);
+}
+
+template<typename T>
+void	sort(T* first, T* last)	{ sort(first, last, Less<T>()); }
+
+template<typename T, typename Cmp>
+void	sort(Array<T>& a, const Cmp& less)	{ sort(a.get(), a.get() + a.size(), less); }
+
+template<typename T>
+void	sort(Array<T>& a)	{ sort(a.get(), a.get() + a.size(), Less<T>()); }
+
+///
+/// stable LSD radix sort on the key returned by key(elem): any 8 to 64 bit integer,
+/// float or double. one byte per pass, passes where every key has the same byte are
+/// skipped. needs a scratch copy of the data, so T must be default constructible
+///
+template<typename T, typename KeyFn>
+void
+radixSort(T* data, size_t n, const KeyFn& key) {
+    typedef typename _RemoveConst<typename _RemoveReference<decltype(key(*data))>::_type>::_type	Key;
+    typedef Detail::RadixKey<Key>	Radix;
+    typedef typename Radix::Bits	Bits;
+    enum { PASSES = sizeof(Bits) };
+
+    if( n < 2 )
+        return;
+
+    // all histograms in one read of the input
+    size_t	counts[PASSES][256];
+    memset(counts, 0, sizeof(counts));
+    for( size_t i = 0; i < n; ++i ) {
+        Bits	b	= Radix::get(key(data[i]));
+        for( size_t p = 0; p < PASSES; ++p )
+            ++counts[p][(b >> (8 * p)) & 0xff];
+    }
+
+    Array<T>	scratch;
+    T*		src	= data;
+    T*		dst	= nullptr;
+    for( size_t p = 0; p < PASSES; ++p ) {
+        size_t*	c	= counts[p];
+        if( c[(Radix::get(key(src[0])) >> (8 * p)) & 0xff] == n )
+            continue;	// every key has this byte in common
+
+        if( !dst ) {
+            scratch.resize(n);
+            dst	= scratch.get();
+        }
+
+        size_t	offset	= 0;
+        for( size_t d = 0; d < 256; ++d ) {
+            size_t	k	= c[d];
+            c[d]	= offset;
+            offset	+= k;
+        }
+        for( size_t i = 0; i < n; ++i )
+            dst[c[(Radix::get(key(src[i])) >> (8 * p)) & 0xff]++]	= move(src[i]);
+
+        T*	t	= src;
+        src	= dst;
+        dst	= t;
+    }
+
+    if( src != data )
+        for( size_t i = 0; i < n; ++i )
+            data[i]	= move(src[i]);
+}
+
+template<typename T, typename KeyFn>
+void	radixSort(Array<T>& a, const KeyFn& key)	{ radixSort(a.get(), a.size(), key); }
+
+template<typename T>
+void	radixSort(Array<T>& a)	{ radixSort(a.get(), a.size(), Detail::IdentityKey<T>()); }
+
+///
+/// branch free binary search: the loop has a fixed trip count of log2(n) and the
+/// comparison only feeds a conditional move, so it does not suffer mispredictions
+/// @return the index of the first element not less than value (n if none)
+///
+template<typename T, typename Cmp>
+size_t
+lowerBound(const T* data, size_t n, const T& value, const Cmp& less) {
+    if( n == 0 )
+        return 0;
+    const T*	base	= data;
+    while( n > 1 ) {
+        size_t	half	= n / 2;
+        __builtin_prefetch(base + half / 2);
+        __builtin_prefetch(base + half + half / 2);
+        base	= less(base[half - 1], value) ? base + half : base;
+        n	-= half;
+    }
+    return size_t(base - data) + (less(*base, value) ? 1 : 0);
+}
+
+template<typename T>
+size_t	lowerBound(const T* data, size_t n, const T& value)	{ return lowerBound(data, n, value, Less<T>()); }
+
+///
+/// @return the index of the first element greater than value (n if none)
+///
+template<typename T, typename Cmp>
+size_t
+upperBound(const T* data, size_t n, const T& value, const Cmp& less) {
+    if( n == 0 )
+        return 0;
+    const T*	base	= data;
+    while( n > 1 ) {
+        size_t	half	= n / 2;
+        base	= less(value, base[half - 1]) ? base : base + half;
+        n	-= half;
+    }
+    return size_t(base - data) + (less(value, *base) ? 0 : 1);
+}
+
+template<typename T>
+size_t	upperBound(const T* data, size_t n, const T& value)	{ return upperBound(data, n, value, Less<T>()); }
+
+///
+/// lower bound by counting: for short runs (a cache line or two) this straight loop
+/// vectorizes and beats any search
+///
+template<typename T>
+size_t
+lowerBoundLinear(const T* data, size_t n, const T& value) {
+    size_t	count	= 0;
+    for( size_t i = 0; i < n; ++i )
+        count	+= data[i] < value;
+    return count;
+}
+
+template<typename T, typename Cmp>
+size_t	lowerBound(const Array<T>& a, const T& value, const Cmp& less)	{ return lowerBound(a.get(), a.size(), value, less); }
+
+template<typename T>
+size_t	lowerBound(const Array<T>& a, const T& value)	{ return lowerBound(a.get(), a.size(), value, Less<T>()); }
+
+template<typename T>
+size_t	upperBound(const Array<T>& a, const T& value)	{ return upperBound(a.get(), a.size(), value, Less<T>()); }
+
+///
+/// @return the index of an element equal to value, or -1
+///
+template<typename T>
+ptrdiff_t
+binarySearch(const Array<T>& a, const T& value) {
+    size_t	i	= lowerBound(a.get(), a.size(), value, Less<T>());
+    return (i < a.size() && !(value < a[i])) ? ptrdiff_t(i) : -1;
+}
+
+}	// namespace BmCpp
@@ -2,6 +2,7 @@
 #define STRING_HPP
 #include <cstring>
 #include "array.hpp"
+#include "number.hpp"
 namespace BmCpp {
 
 ///
@@ -9,11 +10,11 @@ namespace BmCpp {
 ///
 struct String
 {
-    inline String()	{ data.pushBack('\0');	}
+    inline String() : hashCache(0)	{ data.pushBack('\0');	}
 
-    inline String(const String& other) : data(other.data)	{}
+    inline String(const String& other) : data(other.data), hashCache(other.hashCache.load(std::memory_order_relaxed))	{}
 
-    inline String(const char* other) {
+    inline String(const char* other) : hashCache(0) {
         if( other ) {
             size_t len	= strlen(other);
 
@@ -24,7 +25,14 @@ struct String
         }
     }
 
-    inline String(char s) {
+    inline String(const char* other, size_t len) : hashCache(0) {
+        data.resize(len + 1);
+        if( len )
+            memcpy(&(data[0]), other, len);
+        data[len]	= '\0';
+    }
+
+    inline String(char s) : hashCache(0) {
         data.pushBack(s);
         data.pushBack('\0');
     }
@@ -33,14 +41,17 @@ struct String
 
     inline void
     clear()	{
+        hashCache.store(0, std::memory_order_relaxed);
         data.resize(1);
         data[0]	= '\0';
     }
 
     inline String&
     operator = (const String& s) {
-        if( &s != this )	// an idiot is trying to copy himself ?
-            data	= s.data;
+        if( &s != this ) {	// an idiot is trying to copy himself ?
+            data		= s.data;
+            hashCache.store(s.hashCache.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
         return *this;
     }
 
@@ -52,11 +63,7 @@ struct String
             *this	+= scpy;
         }
         else
-        {
-            size_t	len	= data.size();
-            data.resize(data.size() + s.data.size() - 1);
-            strcpy(&(data[len - 1]), &(s.data[0]));
-        }
+            append(&(s.data[0]), s.size());
 
         return *this;
     }
@@ -66,6 +73,7 @@ struct String
     {
         size_t len	= strlen(s);
 
+        hashCache.store(0, std::memory_order_relaxed);
         data.resize(len + 1);
         strcpy(&(data[0]), s);
         return *this;
@@ -74,17 +82,55 @@ struct String
     inline String&
     operator += (const char* s)
     {
-        size_t	slen	= strlen(s);
-        size_t	len     = data.size();
-        data.resize(data.size() + slen);
-        strcpy(&(data[len - 1]), s);
+        return append(s, strlen(s));
+    }
 
+    ///
+    /// append len bytes of s, growing the storage geometrically
+    /// @param s the bytes to append
+    /// @param len the number of bytes
+    /// @return this string
+    ///
+    inline String&
+    append(const char* s, size_t len)
+    {
+        size_t	size	= data.size();
+        hashCache.store(0, std::memory_order_relaxed);
+        reserveExtra(len);
+        data.resize(size + len);
+        memcpy(&(data[size - 1]), s, len);
+        data[size + len - 1]	= '\0';
         return *this;
     }
 
+    inline String&
+    appendInt(int64_t v)
+    {
+        char	buf[MAX_INT_CHARS];
+        return append(buf, formatInt(buf, v));
+    }
+
+    inline String&
+    appendUInt(uint64_t v)
+    {
+        char	buf[MAX_INT_CHARS];
+        return append(buf, formatUInt(buf, v));
+    }
+
+    ///
+    /// append text that parses back to exactly v, see formatDouble()
+    ///
+    inline String&
+    appendDouble(double v)
+    {
+        char	buf[MAX_DOUBLE_CHARS];
+        return append(buf, formatDouble(buf, v));
+    }
+
     inline String&
     operator = (char s)
     {
+        hashCache.store(0, std::memory_order_relaxed);
         data.resize(2);
         data[0]	= s;
         data[1]	= '\0';
@@ -94,63 +140,442 @@ struct String
     inline String&
     operator += (char s)
     {
+        hashCache.store(0, std::memory_order_relaxed);
+        reserveExtra(1);
         data[data.size() - 1]	= s;
         data.pushBack('\0');
         return *this;
     }
 
+    ///
+    /// three way comparison of the raw bytes, embedded '\0' included
+    /// @param s the string to compare to
+    /// @return < 0, 0 or > 0 as this string sorts before, equal or after s
+    ///
+    inline int
+    compare(const String& s) const
+    {
+        size_t	len	= size();
+        size_t	slen	= s.size();
+        int	r	= memcmp(c_str(), s.c_str(), len < slen ? len : slen);
+        if( r != 0 )
+            return r;
+        return len < slen ? -1 : (len > slen ? 1 : 0);
+    }
+
     inline bool
     operator == (const String& s) const
     {
-        return (strcmp(&(s.data[0]), &(data[0])) == 0);
+        // lengths first, only then the bytes
+        return size() == s.size()
+            && memcmp(c_str(), s.c_str(), size()) == 0;
     }
 
     inline bool
     operator != (const String& s) const
     {
-        return (strcmp(&(s.data[0]), &(data[0])) != 0);
+        return !(*this == s);
+    }
+
+    inline bool
+    operator == (const char* s) const
+    {
+        size_t	slen	= strlen(s);
+        return size() == slen && memcmp(c_str(), s, slen) == 0;
+    }
+
+    inline bool
+    operator != (const char* s) const
+    {
+        return !(*this == s);
     }
 
     inline bool
     operator < (const String& s) const
     {
-        return (strcmp(&(data[0]), &(s.data[0])) < 0 );
+        return compare(s) < 0;
     }
 
     inline bool
     operator > (const String& s) const
     {
-        return (strcmp(&(data[0]), &(s.data[0])) > 0 );
+        return compare(s) > 0;
     }
 
     inline String
     operator + (const String& s) const
     {
-        String	temp(*this);
+        String	temp;
+        temp.data.reserve(size() + s.size() + 1);
+        temp.append(c_str(), size());
         return (temp += s);
     }
 
     inline String
     operator + (const char* s) const
     {
-        String	temp(*this);
-        return (temp += s);
+        size_t	slen	= strlen(s);
+        String	temp;
+        temp.data.reserve(size() + slen + 1);
+        temp.append(c_str(), size());
+        return temp.append(s, slen);
     }
 
     inline size_t		length() const	{	return data.size() - 1;	}
     inline size_t		size() const	{	return data.size() - 1;	}
 
     inline char		operator[] (size_t i) const	{		return data[i];	}
-    inline char&		operator[] (size_t i)		{		return data[i];	}
+
+    ///
+    /// writable character. the cached hash is dropped when the reference is handed out,
+    /// so a reference kept across a later hash() call must not be written through; use
+    /// setAt() for that
+    ///
+    inline char&		operator[] (size_t i)		{	hashCache.store(0, std::memory_order_relaxed);	return data[i];	}
+
+    ///
+    /// overwrite one character, the cached hash is always dropped with it
+    ///
+    inline void
+    setAt(size_t i, char c)
+    {
+        hashCache.store(0, std::memory_order_relaxed);
+        data[i]	= c;
+    }
+
+    ///
+    /// hash of the string bytes, computed on first use and cached until the next mutation.
+    /// const Strings can be hashed from several threads at once: racing threads compute
+    /// the same value and the cache is a relaxed atomic
+    /// @return the hash, never 0
+    ///
+    inline uint32_t
+    hash() const
+    {
+        uint32_t	h	= hashCache.load(std::memory_order_relaxed);
+        if( h == 0 ) {
+            h	= hashBytes(c_str(), size());
+            hashCache.store(h, std::memory_order_relaxed);
+        }
+        return h;
+    }
 
     inline const char*	c_str() const			{	return &(data[0]);		}
 
 private:
+    ///
+    /// make room for extra more bytes, doubling the capacity so repeated appends stay linear
+    ///
+    inline void
+    reserveExtra(size_t extra)
+    {
+        size_t	need	= data.size() + extra;
+        if( need > data.capacity() ) {
+            size_t	cap	= data.capacity() * 2;
+            data.reserve(cap > need ? cap : need);
+        }
+    }
+
+    ///
+    /// murmur3 (x86_32) over the bytes, 0 is remapped as it marks an empty cache
+    ///
+    static inline uint32_t
+    hashBytes(const char* s, size_t len)
+    {
+        const uint32_t	c1	= 0xcc9e2d51;
+        const uint32_t	c2	= 0x1b873593;
+        uint32_t	h	= uint32_t(len);
+        size_t		i	= 0;
+
+        for( ; i + 4 <= len; i += 4 ) {
+            uint32_t	k;
+            memcpy(&k, s + i, 4);
+            k	*= c1;
+            k	= (k << 15) | (k >> 17);
+            k	*= c2;
+            h	^= k;
+            h	= (h << 13) | (h >> 19);
+            h	= h * 5 + 0xe6546b64;
+        }
+
+        uint32_t	k	= 0;
+        switch( len & 3 ) {
+        case 3: k	^= uint32_t(uint8_t(s[i + 2])) << 16;	// fallthrough
+        case 2: k	^= uint32_t(uint8_t(s[i + 1])) << 8;	// fallthrough
+        case 1: k	^= uint32_t(uint8_t(s[i]));
+            k	*= c1;
+            k	= (k << 15) | (k >> 17);
+            k	*= c2;
+            h	^= k;
+        }
+
+        h	^= uint32_t(len);
+        h	= hashFn<uint32_t>(h);
+        return h ? h : 1;
+    }
+
     Array<char>		data;		///< the actual string data
+    mutable std::atomic<uint32_t>	hashCache;	///< 0 until hash() is called after a mutation
+
+    friend struct	StringBuilder;
 };	// struct string
 
 inline String operator + (const char* cstr, const String& str) {	return (String(cstr) + str);	}
 
+///
+/// non owning window over a run of bytes, usually part of a String or of an input buffer.
+/// the bytes are not '\0' terminated
+///
+struct StringView
+{
+    inline StringView() : ptr(""), len(0)	{}
+    inline StringView(const char* s) : ptr(s), len(strlen(s))	{}
+    inline StringView(const char* s, size_t len) : ptr(s), len(len)	{}
+    inline StringView(const String& s) : ptr(s.c_str()), len(s.size())	{}
+
+    inline size_t		size() const	{	return len;	}
+    inline bool		empty() const	{	return len == 0;	}
+    inline const char*	data() const	{	return ptr;	}
+
+    inline char		operator[] (size_t i) const	{	return ptr[i];	}
+
+    ///
+    /// @param pos the first byte, clamped to size()
+    /// @param n the maximum number of bytes
+    /// @return the sub view [pos, pos + n)
+    ///
+    inline StringView
+    substr(size_t pos, size_t n = size_t(-1)) const
+    {
+        if( pos > len )
+            pos	= len;
+        if( n > len - pos )
+            n	= len - pos;
+        return StringView(ptr + pos, n);
+    }
+
+    inline bool
+    operator == (const StringView& s) const
+    {
+        return len == s.len && memcmp(ptr, s.ptr, len) == 0;
+    }
+
+    inline bool
+    operator != (const StringView& s) const
+    {
+        return !(*this == s);
+    }
+
+    inline String	toString() const	{	return String(ptr, len);	}
+
+private:
+    const char*		ptr;
+    size_t		len;
+};	// struct StringView
+
+inline String	toString(long long v)		{	return String().appendInt(v);	}
+inline String	toString(long v)		{	return String().appendInt(v);	}
+inline String	toString(int v)			{	return String().appendInt(v);	}
+inline String	toString(unsigned long long v)	{	return String().appendUInt(v);	}
+inline String	toString(unsigned long v)	{	return String().appendUInt(v);	}
+inline String	toString(unsigned v)		{	return String().appendUInt(v);	}
+inline String	toString(double v)		{	return String().appendDouble(v);	}
+
+///
+/// parse the whole view as a decimal integer
+/// @param s the text
+/// @param out receives the value on success
+/// @return false on stray characters or overflow
+///
+inline bool	parseInt(const StringView& s, int64_t& out)	{	return parseInt(s.data(), s.size(), out);	}
+inline bool	parseUInt(const StringView& s, uint64_t& out)	{	return parseUInt(s.data(), s.size(), out);	}
+
+///
+/// parse the whole view as a floating point number, correctly rounded
+/// @param s the text
+/// @param out receives the value on success
+/// @return false if s is not a number
+///
+inline bool	parseDouble(const StringView& s, double& out)	{	return parseDouble(s.data(), s.size(), out);	}
+
+///
+/// accumulates fragments into a chain of geometrically growing chunks and
+/// produces the final String in one allocation. Appending never moves what
+/// was already written, and once the chunks reach MAX_CHUNK_SIZE they stop
+/// growing, so very large outputs become a rope that can be streamed out
+/// with foreachChunk() without ever being flattened.
+///
+struct StringBuilder : public BaseAllocation, private NonCopyable
+{
+    enum
+    {
+        MIN_CHUNK_SIZE	= 256,
+        MAX_CHUNK_SIZE	= 1 << 20
+    };
+
+    inline StringBuilder() : head(nullptr), tail(nullptr), length(0)	{}
+
+    inline ~StringBuilder() {
+        Chunk*	c	= head;
+        while( c ) {
+            Chunk*	next	= c->next;
+            free(c);
+            c	= next;
+        }
+    }
+
+    ///
+    /// forget the content but keep the chunks around for the next round
+    ///
+    inline void
+    clear() {
+        for( Chunk* c = head; c; c = c->next )
+            c->used	= 0;
+        tail	= head;
+        length	= 0;
+    }
+
+    inline size_t		size() const	{	return length;	}
+
+    ///
+    /// get a contiguous window of at least n writable bytes at the end of the builder.
+    /// the bytes are only part of the content once commit() is called
+    /// @param n the number of bytes needed
+    /// @return the window start
+    ///
+    inline char*
+    reserve(size_t n) {
+        if( !tail || tail->capacity - tail->used < n ) {
+            // the next chunk may already exist if clear() was called
+            if( tail && tail->next && tail->next->capacity >= n )
+                tail	= tail->next;
+            else
+                addChunk(n);
+        }
+        return tail->data + tail->used;
+    }
+
+    ///
+    /// make the first n bytes of the last reserve() window part of the content
+    ///
+    inline void
+    commit(size_t n) {
+        tail->used	+= n;
+        length		+= n;
+    }
+
+    inline StringBuilder&
+    append(const char* s, size_t len) {
+        while( len ) {
+            if( !tail || tail->used == tail->capacity )
+                reserve(1);
+
+            size_t	room	= tail->capacity - tail->used;
+            size_t	n	= len < room ? len : room;
+            memcpy(tail->data + tail->used, s, n);
+            commit(n);
+            s	+= n;
+            len	-= n;
+        }
+        return *this;
+    }
+
+    inline StringBuilder&	append(const char* s)		{	return append(s, strlen(s));	}
+    inline StringBuilder&	append(const String& s)		{	return append(s.c_str(), s.size());	}
+
+    inline StringBuilder&
+    append(char c) {
+        *reserve(1)	= c;
+        commit(1);
+        return *this;
+    }
+
+    inline StringBuilder&
+    appendInt(int64_t v) {
+        commit(formatInt(reserve(MAX_INT_CHARS), v));
+        return *this;
+    }
+
+    inline StringBuilder&
+    appendUInt(uint64_t v) {
+        commit(formatUInt(reserve(MAX_INT_CHARS), v));
+        return *this;
+    }
+
+    inline StringBuilder&
+    appendDouble(double v) {
+        commit(formatDouble(reserve(MAX_DOUBLE_CHARS), v));
+        return *this;
+    }
+
+    ///
+    /// call fn(const char* bytes, size_t len) on every non empty chunk in order
+    ///
+    template<typename Fn>
+    void
+    foreachChunk(Fn&& fn) const {
+        for( Chunk* c = head; c; c = c->next ) {
+            if( c->used )
+                fn(static_cast<const char*>(c->data), c->used);
+            if( c == tail )
+                break;
+        }
+    }
+
+    ///
+    /// flatten the content into a String, with a single allocation
+    ///
+    inline String
+    toString() const {
+        String	res;
+        res.data.resize(length + 1);
+        char*	dst	= &(res.data[0]);
+        foreachChunk([&dst](const char* s, size_t len) {
+            memcpy(dst, s, len);
+            dst	+= len;
+        });
+        *dst	= '\0';
+        return res;
+    }
+
+private:
+    struct Chunk
+    {
+        Chunk*		next;
+        size_t		used;
+        size_t		capacity;
+        char		data[1];
+    };
+
+    inline void
+    addChunk(size_t n) {
+        size_t	cap	= tail ? tail->capacity * 2 : size_t(MIN_CHUNK_SIZE);
+        if( cap > MAX_CHUNK_SIZE )
+            cap	= MAX_CHUNK_SIZE;
+        if( cap < n )
+            cap	= n;
+
+        Chunk*	c	= static_cast<Chunk*>(malloc(sizeof(Chunk) + cap));
+        assert(c != nullptr);
+        c->used		= 0;
+        c->capacity	= cap;
+
+        if( tail ) {
+            // a chunk too small for the window is kept, after the new one, for later use
+            c->next		= tail->next;
+            tail->next	= c;
+        } else {
+            c->next		= head;
+            head		= c;
+        }
+        tail	= c;
+    }
+
+    Chunk*		head;
+    Chunk*		tail;
+    size_t		length;
+};	// struct StringBuilder
+
 
 ///
 /// make a string upper case
@@ -189,15 +614,7 @@ template<>
 inline
 uint32_t
 hashFn<String>(const String& s) {
-    uint32_t    h   = 0;
-    for( size_t i = 0; i < s.size(); ++i ) {
-        h ^= s[i] >> 16;
-        h *= 0x85ebca6b;
-        h ^= h >> 13;
-        h *= 0xc2b2ae35;
-        h ^= h >> 16;
-    }
-    return h;
+    return s.hash();
 }
 }   // namespace BmCpp
 
@@ -0,0 +1,465 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "lambda.hpp"
+#include "queue.hpp"
+#include "pool.hpp"
+
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+
+namespace BmCpp {
+
+///
+/// Chase-Lev work stealing deque of pointers (the C11 formulation by Le, Pop, Cohen and
+/// Zappa Nardelli). the owner pushes and takes at the bottom without contention, thieves
+/// steal from the top with one CAS. the ring grows on demand; outgrown rings are kept
+/// until the deque dies because a thief may still be reading them
+///
+template<typename T>
+struct WorkStealingDeque : public BaseAllocation, private NonCopyable
+{
+    explicit WorkStealingDeque(size_t capacity = 256) : top(0), bottom(0), retired(nullptr) {
+        size_t	c	= 2;
+        while( c < capacity )
+            c	<<= 1;
+        ring.store(newRing(c, nullptr), std::memory_order_relaxed);
+    }
+
+    ~WorkStealingDeque() {
+        Ring*	r	= ring.load(std::memory_order_relaxed);
+        r->next	= retired;
+        while( r ) {
+            Ring*	next	= r->next;
+            free(r);
+            r	= next;
+        }
+    }
+
+    ///
+    /// owner only
+    ///
+    void
+    push(T* t) {
+        int64_t	b	= bottom.load(std::memory_order_relaxed);
+        int64_t	tp	= top.load(std::memory_order_acquire);
+        Ring*	r	= ring.load(std::memory_order_relaxed);
+        if( b - tp > int64_t(r->mask) )
+            r	= grow(r, tp, b);
+        r->slots[b & r->mask].store(t, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_release);	// pairs with the acquire in steal()
+    }
+
+    ///
+    /// owner only, LIFO
+    /// @return the newest element or nullptr
+    ///
+    T*
+    take() {
+        int64_t	b	= bottom.load(std::memory_order_relaxed) - 1;
+        Ring*	r	= ring.load(std::memory_order_relaxed);
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t	tp	= top.load(std::memory_order_relaxed);
+
+        if( tp > b ) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T*	t	= r->slots[b & r->mask].load(std::memory_order_relaxed);
+        if( tp == b ) {
+            // last element: race the thieves for it
+            if( !top.compare_exchange_strong(tp, tp + 1, std::memory_order_seq_cst, std::memory_order_relaxed) )
+                t	= nullptr;
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return t;
+    }
+
+    ///
+    /// any thread, FIFO
+    /// @return the oldest element or nullptr if empty or lost to another thread
+    ///
+    T*
+    steal() {
+        int64_t	tp	= top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t	b	= bottom.load(std::memory_order_acquire);
+        if( tp >= b )
+            return nullptr;
+
+        Ring*	r	= ring.load(std::memory_order_acquire);
+        T*	t	= r->slots[tp & r->mask].load(std::memory_order_relaxed);
+        if( !top.compare_exchange_strong(tp, tp + 1, std::memory_order_seq_cst, std::memory_order_relaxed) )
+            return nullptr;
+        return t;
+    }
+
+    bool
+    empty() const {
+        return bottom.load(std::memory_order_relaxed) <= top.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Ring
+    {
+        size_t			mask;
+        Ring*			next;	///< chain of outgrown rings
+        std::atomic<T*>		slots[1];
+    };
+
+    static Ring*
+    newRing(size_t capacity, Ring* next) {
+        Ring*	r	= static_cast<Ring*>(malloc(sizeof(Ring) + (capacity - 1) * sizeof(std::atomic<T*>)));
+        assert(r != nullptr);
+        r->mask	= capacity - 1;
+        r->next	= next;
+        return r;
+    }
+
+    Ring*
+    grow(Ring* old, int64_t tp, int64_t b) {
+        Ring*	r	= newRing((old->mask + 1) * 2, nullptr);
+        for( int64_t i = tp; i < b; ++i )
+            r->slots[i & r->mask].store(old->slots[i & old->mask].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        old->next	= retired;
+        retired		= old;
+        ring.store(r, std::memory_order_release);
+        return r;
+    }
+
+    std::atomic<int64_t>	top;		///< stolen end, shared
+    char			pad0[CACHE_LINE_SIZE - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t>	bottom;		///< owner end
+    std::atomic<Ring*>		ring;
+    Ring*			retired;
+    char			pad1[CACHE_LINE_SIZE];
+};	// struct WorkStealingDeque
+
+struct TaskGroup;
+
+///
+/// work stealing thread pool running Lambda<void()> tasks.
+///
+/// every worker owns a WorkStealingDeque: tasks spawned on a worker go to its own deque
+/// and run LIFO there, idle workers steal the oldest ones. tasks submitted from outside
+/// go through a shared injection ring, tasks with an affinity hint through the mailbox
+/// of that worker, which moves them into its deque (where they can still be stolen).
+/// idle workers spin briefly, then sleep until new work is published
+///
+struct ThreadPool : public BaseAllocation, private NonCopyable
+{
+    enum
+    {
+        NO_AFFINITY	= -1,
+        INJECT_CAPACITY	= 4096,
+        IDLE_SPINS	= 64	///< failed scans before a worker goes to sleep
+    };
+
+    ///
+    /// @param threads number of workers, 0 for one per online cpu
+    ///
+    explicit ThreadPool(size_t threads = 0)
+        : workerCount(threads), workers(nullptr), injected(INJECT_CAPACITY)
+        , running(true), joined(false), sleepers(0), version(0), nextInbox(0) {
+        if( workerCount == 0 ) {
+            long	n	= sysconf(_SC_NPROCESSORS_ONLN);
+            workerCount	= n > 0 ? size_t(n) : 1;
+        }
+
+        pthread_mutex_init(&sleepLock, nullptr);
+        pthread_cond_init(&wakeUp, nullptr);
+
+        workers	= static_cast<Worker**>(malloc(workerCount * sizeof(Worker*)));
+        for( size_t i = 0; i < workerCount; ++i )
+            workers[i]	= new Worker(this, i);
+        for( size_t i = 0; i < workerCount; ++i )
+            pthread_create(&workers[i]->thread, nullptr, &ThreadPool::workerMain, workers[i]);
+    }
+
+    ///
+    /// runs every task already submitted, then stops the workers. tasks that still
+    /// come in while shutting down (submitted by the last tasks, or pinned to a
+    /// worker that already left) run on the destroying thread
+    ///
+    ~ThreadPool() {
+        pthread_mutex_lock(&sleepLock);
+        running.store(false);
+        ++version;
+        pthread_cond_broadcast(&wakeUp);
+        pthread_mutex_unlock(&sleepLock);
+
+        for( size_t i = 0; i < workerCount; ++i )
+            pthread_join(workers[i]->thread, nullptr);
+        joined.store(true);
+        while( Task* t = findWork(nullptr) )
+            run(t);
+
+        for( size_t i = 0; i < workerCount; ++i )
+            delete workers[i];
+        free(workers);
+
+        pthread_cond_destroy(&wakeUp);
+        pthread_mutex_destroy(&sleepLock);
+    }
+
+    ///
+    /// queue fn for execution
+    /// @param affinity preferred worker index (modulo the worker count) or NO_AFFINITY
+    ///
+    void
+    submit(Lambda<void()>&& fn, int affinity = NO_AFFINITY) {
+        schedule(new Task(move(fn), nullptr), affinity);
+    }
+
+    size_t		size() const	{ return workerCount;	}
+
+    ///
+    /// @return the index of the calling worker of this pool, or -1 from other threads
+    ///
+    int
+    currentWorker() const {
+        Worker*	w	= current();
+        return (w && w->pool == this) ? int(w->index) : -1;
+    }
+
+private:
+    friend struct TaskGroup;
+
+    struct Task
+    {
+        Task(Lambda<void()>&& fn, TaskGroup* group) : fn(move(fn)), group(group)	{}
+
+        inline void*	operator new(size_t) noexcept		{ return ObjectPool<Task>::allocate(); }
+        inline void	operator delete(void* p) noexcept	{ ObjectPool<Task>::deallocate(p); }
+
+        Lambda<void()>	fn;
+        TaskGroup*	group;
+        MpscHook	hook;
+    };
+
+    struct Worker : public BaseAllocation
+    {
+        Worker(ThreadPool* pool, size_t index) : pool(pool), index(index), seed(uint32_t(index) * 2654435761u + 1)	{}
+
+        WorkStealingDeque<Task>			deque;
+        IntrusiveMpscQueue<Task, &Task::hook>	inbox;
+        ThreadPool*				pool;
+        size_t					index;
+        uint32_t				seed;	///< victim selection
+        pthread_t				thread;
+    };
+
+    static Worker*&
+    current() {
+        static thread_local Worker*	w	= nullptr;
+        return w;
+    }
+
+    void
+    schedule(Task* t, int affinity) {
+        Worker*	w	= current();
+        if( affinity == NO_AFFINITY && w && w->pool == this ) {
+            w->deque.push(t);
+            notify();
+            return;
+        }
+
+        if( affinity == NO_AFFINITY && injected.tryPush(t) ) {
+            notify();
+            return;
+        }
+
+        // pinned, or the injection ring is full: use a mailbox
+        size_t	target	= affinity == NO_AFFINITY
+                          ? nextInbox.fetch_add(1, std::memory_order_relaxed)
+                          : size_t(affinity);
+        workers[target % workerCount]->inbox.push(*t);
+        notifyAll();	// only the owner reads its mailbox
+    }
+
+    ///
+    /// find something to run for w (nullptr for a non worker thread)
+    ///
+    Task*
+    findWork(Worker* w) {
+        Task*	t	= nullptr;
+        if( w ) {
+            if( (t = w->deque.take()) )
+                return t;
+            while( Task* in = w->inbox.pop() )
+                w->deque.push(in);
+            if( (t = w->deque.take()) )
+                return t;
+        }
+
+        if( injected.tryPop(t) )
+            return t;
+
+        // once the workers are gone their mailboxes have no reader but the destroying thread
+        if( !w && joined.load(std::memory_order_relaxed) )
+            for( size_t i = 0; i < workerCount; ++i )
+                if( (t = workers[i]->inbox.pop()) )
+                    return t;
+
+        // steal, starting from a random victim
+        uint32_t	start	= 0;
+        if( w ) {
+            w->seed	^= w->seed << 13;
+            w->seed	^= w->seed >> 17;
+            w->seed	^= w->seed << 5;
+            start	= w->seed;
+        }
+        for( size_t i = 0; i < workerCount; ++i ) {
+            Worker*	victim	= workers[(start + i) % workerCount];
+            if( victim != w && (t = victim->deque.steal()) )
+                return t;
+        }
+        return nullptr;
+    }
+
+    void	run(Task* t);
+
+    void
+    notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);	// publish the task before looking for sleepers
+        if( sleepers.load(std::memory_order_relaxed) > 0 ) {
+            pthread_mutex_lock(&sleepLock);
+            ++version;
+            pthread_cond_signal(&wakeUp);
+            pthread_mutex_unlock(&sleepLock);
+        }
+    }
+
+    void
+    notifyAll() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if( sleepers.load(std::memory_order_relaxed) > 0 ) {
+            pthread_mutex_lock(&sleepLock);
+            ++version;
+            pthread_cond_broadcast(&wakeUp);
+            pthread_mutex_unlock(&sleepLock);
+        }
+    }
+
+    ///
+    /// park w until notified. returns at once if work shows up while registering
+    ///
+    Task*
+    sleep(Worker* w) {
+        pthread_mutex_lock(&sleepLock);
+        sleepers.fetch_add(1, std::memory_order_seq_cst);
+        uint64_t	seen	= version;
+        pthread_mutex_unlock(&sleepLock);
+
+        // re-scan now that submitters can see us
+        Task*	t	= findWork(w);
+        if( t || !running.load() ) {
+            sleepers.fetch_sub(1, std::memory_order_relaxed);
+            return t;
+        }
+
+        pthread_mutex_lock(&sleepLock);
+        while( version == seen && running.load() )
+            pthread_cond_wait(&wakeUp, &sleepLock);
+        sleepers.fetch_sub(1, std::memory_order_relaxed);
+        pthread_mutex_unlock(&sleepLock);
+        return nullptr;
+    }
+
+    static void*
+    workerMain(void* arg) {
+        Worker*		w	= static_cast<Worker*>(arg);
+        ThreadPool*	pool	= w->pool;
+        current()	= w;
+
+        size_t	idle	= 0;
+        for(;;) {
+            Task*	t	= pool->findWork(w);
+            if( !t ) {
+                // everything published before the shutdown is visible now, look once more
+                if( !pool->running.load() && !(t = pool->findWork(w)) )
+                    break;
+            }
+            if( !t ) {
+                if( ++idle < IDLE_SPINS ) {
+                    sched_yield();
+                    continue;
+                }
+                t	= pool->sleep(w);
+                idle	= 0;
+                if( !t )
+                    continue;
+            }
+            idle	= 0;
+            pool->run(t);
+        }
+
+        current()	= nullptr;
+        return nullptr;
+    }
+
+    size_t			workerCount;
+    Worker**		workers;
+    MpmcQueue<Task*>	injected;	///< tasks submitted from outside the pool
+    std::atomic<bool>	running;
+    std::atomic<bool>	joined;		///< set by the destructor once no worker is left
+    std::atomic<size_t>	sleepers;
+    uint64_t		version;	///< wake-up generation, guarded by sleepLock
+    std::atomic<size_t>	nextInbox;
+    pthread_mutex_t		sleepLock;
+    pthread_cond_t		wakeUp;
+};	// struct ThreadPool
+
+///
+/// fork/join scope: spawn() runs tasks on the pool, wait() returns once all of them
+/// (and whatever they spawned into the group) are done. a waiting worker keeps
+/// executing pool tasks instead of blocking
+///
+struct TaskGroup : private NonCopyable
+{
+    explicit TaskGroup(ThreadPool& pool) : pool(pool), pending(0)	{}
+
+    ~TaskGroup() {
+        wait();
+    }
+
+    void
+    spawn(Lambda<void()>&& fn, int affinity = ThreadPool::NO_AFFINITY) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        pool.schedule(new ThreadPool::Task(move(fn), this), affinity);
+    }
+
+    void
+    wait() {
+        ThreadPool::Worker*	w	= ThreadPool::current();
+        if( w && w->pool != &pool )
+            w	= nullptr;
+
+        while( pending.load(std::memory_order_acquire) != 0 ) {
+            if( ThreadPool::Task* t = pool.findWork(w) )
+                pool.run(t);
+            else
+                sched_yield();
+        }
+    }
+
+private:
+    friend struct ThreadPool;
+
+    ThreadPool&		pool;
+    std::atomic<size_t>	pending;
+};	// struct TaskGroup
+
+inline void
+ThreadPool::run(Task* t) {
+    t->fn();
+    TaskGroup*	g	= t->group;
+    delete t;
+    if( g )
+        g->pending.fetch_sub(1, std::memory_order_release);
+}
+
+}	// namespace BmCpp
@@ -0,0 +1,188 @@
+#pragma once
+
+#include "cpp-rt.hpp"
+#include "lambda.hpp"
+#include "list.hpp"
+
+#include <cstdint>
+
+namespace BmCpp {
+
+struct TimerWheel;
+
+///
+/// a timer owned by the caller and linked into a TimerWheel while it is scheduled.
+/// it must be cancelled (or have fired) before it is destroyed
+///
+struct Timer : private NonCopyable
+{
+    Timer() : expires(0), level(0), slot(0)	{}
+
+    bool		isScheduled() const	{ return hook.isLinked();	}
+    uint64_t		deadline() const	{ return expires;	}
+
+private:
+    ListHook		hook;
+    uint64_t		expires;
+    uint8_t		level;
+    uint8_t		slot;
+    Lambda<void()>	fn;
+
+    friend struct TimerWheel;
+};
+
+///
+/// hierarchical timer wheel (Varghese & Lauck) counting in caller defined ticks.
+/// level 0 has one slot per tick, each level above has slots 64 times as wide; a
+/// timer goes in the level its distance falls into and is cascaded one level down
+/// each time the level below wraps around. schedule() and cancel() are O(1) list
+/// operations, advance() touches one slot per tick plus the timers it cascades.
+/// timers further out than the wheel spans wait in the last level and are cascaded
+/// again until they come in range
+///
+struct TimerWheel : private NonCopyable
+{
+    enum
+    {
+        SLOT_BITS	= 6,
+        SLOTS		= 1 << SLOT_BITS,
+        LEVELS		= 4
+    };
+
+    explicit TimerWheel(uint64_t now = 0) : current(now), pending(0)	{}
+
+    ~TimerWheel() {
+        for( int l = 0; l < LEVELS; ++l )
+            for( int s = 0; s < SLOTS; ++s )
+                while( !slots[l][s].empty() ) {
+                    Timer&	t	= slots[l][s].front();
+                    slots[l][s].pop_front();
+                    t.fn.reset();
+                }
+    }
+
+    uint64_t	now() const	{ return current;	}
+    size_t		size() const	{ return pending;	}
+
+    ///
+    /// arm t to call fn once advance() reaches deadline. a deadline that has already
+    /// passed fires on the next tick. scheduling an armed timer moves it
+    ///
+    void
+    schedule(Timer& t, uint64_t deadline, Lambda<void()>&& fn) {
+        if( t.isScheduled() )
+            cancel(t);
+        t.expires	= deadline;
+        t.fn		= move(fn);
+        place(t, deadline > current ? deadline : current + 1);
+        ++pending;
+    }
+
+    ///
+    /// disarm t without calling it
+    /// @return false if t was not scheduled
+    ///
+    bool
+    cancel(Timer& t) {
+        if( !t.isScheduled() )
+            return false;
+        slots[t.level][t.slot].erase(t);
+        t.fn.reset();
+        --pending;
+        return true;
+    }
+
+    ///
+    /// move time forward to now, calling every timer whose deadline is reached, one
+    /// tick after the other. callbacks may schedule and cancel timers, including the
+    /// one being run
+    /// @return the number of timers fired
+    ///
+    size_t
+    advance(uint64_t now) {
+        size_t	fired	= 0;
+        while( current < now ) {
+            if( pending == 0 ) {
+                current	= now;
+                break;
+            }
+            ++current;
+
+            // cascade each level whose index the level below just wrapped into
+            size_t	index	= size_t(current & (SLOTS - 1));
+            for( int l = 1; l < LEVELS && index == 0; ++l ) {
+                index	= size_t((current >> (l * SLOT_BITS)) & (SLOTS - 1));
+                cascade(l, index);
+            }
+
+            IntrusiveList<Timer, &Timer::hook>&	due	= slots[0][current & (SLOTS - 1)];
+            while( !due.empty() ) {
+                Timer&	t	= due.front();
+                due.pop_front();
+                --pending;
+                Lambda<void()>	fn(move(t.fn));
+                fn();
+                ++fired;
+            }
+        }
+        return fired;
+    }
+
+    ///
+    /// @return the tick the earliest timer fires on, or UINT64_MAX when nothing is
+    /// scheduled. good for choosing how long to sleep before the next advance(). costs
+    /// a scan of the first occupied slot of each level
+    ///
+    uint64_t
+    nextExpiry() const {
+        uint64_t	best	= UINT64_MAX;
+        if( pending == 0 )
+            return best;
+        // within a level slots fire in order, so only the first occupied one matters
+        for( int l = 0; l < LEVELS; ++l ) {
+            uint64_t	base	= current >> (l * SLOT_BITS);
+            for( uint64_t k = 1; k <= SLOTS; ++k ) {
+                const IntrusiveList<Timer, &Timer::hook>&	slot	= slots[l][(base + k) & (SLOTS - 1)];
+                if( slot.empty() )
+                    continue;
+                for( IntrusiveList<Timer, &Timer::hook>::ConstIterator it = slot.cbegin(); it != slot.cend(); ++it ) {
+                    uint64_t	t	= it->expires > current ? it->expires : current + 1;	// overdue ones fire next tick
+                    if( t < best )
+                        best	= t;
+                }
+                break;
+            }
+        }
+        return best;
+    }
+
+private:
+    void
+    place(Timer& t, uint64_t when) {
+        uint64_t	delta	= when - current;
+        int		l	= 0;
+        while( l < LEVELS - 1 && delta >= (uint64_t(1) << ((l + 1) * SLOT_BITS)) )
+            ++l;
+        if( delta >= (uint64_t(1) << (LEVELS * SLOT_BITS)) )
+            when	= current + (uint64_t(1) << (LEVELS * SLOT_BITS)) - 1;	// park in the last slot in reach
+        t.level	= uint8_t(l);
+        t.slot	= uint8_t((when >> (l * SLOT_BITS)) & (SLOTS - 1));
+        slots[l][t.slot].push_back(t);
+    }
+
+    void
+    cascade(int l, size_t index) {
+        IntrusiveList<Timer, &Timer::hook>&	list	= slots[l][index];
+        while( !list.empty() ) {
+            Timer&	t	= list.front();
+            list.pop_front();
+            place(t, t.expires > current ? t.expires : current);
+        }
+    }
+
+    IntrusiveList<Timer, &Timer::hook>	slots[LEVELS][SLOTS];
+    uint64_t				current;
+    size_t				pending;
+};
+
+}	// namespace BmCpp
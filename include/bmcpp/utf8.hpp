@@ -0,0 +1,599 @@
+#pragma once
+
+#include "string.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace BmCpp {
+
+///
+/// UTF-8 validation, counting, iteration and transcoding over String / Array<char> bytes.
+///
+/// validation uses the Keiser-Lemire lookup algorithm (as in simdjson/simdutf) when SSSE3 is
+/// available, and an ASCII block fast path in front of a scalar state machine otherwise.
+/// nothing here allocates except the Array front ends.
+///
+
+enum
+{
+    REPLACEMENT_CHARACTER	= 0xFFFD
+};
+
+namespace Detail {
+
+inline bool
+isAscii8(const char* s) {
+    uint64_t	w;
+    memcpy(&w, s, sizeof(w));
+    return (w & 0x8080808080808080ull) == 0;
+}
+
+///
+/// decode one code point starting at p, p < end.
+/// @param len receives the sequence length, 0 if the sequence is invalid
+///
+inline uint32_t
+decodeOne(const uint8_t* p, const uint8_t* end, size_t& len) {
+    uint32_t	b0	= p[0];
+    len	= 0;
+    if( b0 < 0x80 ) {
+        len	= 1;
+        return b0;
+    }
+
+    size_t	avail	= size_t(end - p);
+    if( b0 < 0xC2 ) {
+        return 0;
+    } else if( b0 < 0xE0 ) {
+        if( avail < 2 || (p[1] & 0xC0) != 0x80 )
+            return 0;
+        len	= 2;
+        return ((b0 & 0x1F) << 6) | (p[1] & 0x3F);
+    } else if( b0 < 0xF0 ) {
+        if( avail < 3 )
+            return 0;
+        uint32_t	b1	= p[1];
+        uint32_t	lo	= b0 == 0xE0 ? 0xA0 : 0x80;	// overlong
+        uint32_t	hi	= b0 == 0xED ? 0x9F : 0xBF;	// surrogates
+        if( b1 < lo || b1 > hi || (p[2] & 0xC0) != 0x80 )
+            return 0;
+        len	= 3;
+        return ((b0 & 0x0F) << 12) | ((b1 & 0x3F) << 6) | (p[2] & 0x3F);
+    } else if( b0 < 0xF5 ) {
+        if( avail < 4 )
+            return 0;
+        uint32_t	b1	= p[1];
+        uint32_t	lo	= b0 == 0xF0 ? 0x90 : 0x80;	// overlong
+        uint32_t	hi	= b0 == 0xF4 ? 0x8F : 0xBF;	// > U+10FFFF
+        if( b1 < lo || b1 > hi || (p[2] & 0xC0) != 0x80 || (p[3] & 0xC0) != 0x80 )
+            return 0;
+        len	= 4;
+        return ((b0 & 0x07) << 18) | ((b1 & 0x3F) << 12) | ((uint32_t(p[2]) & 0x3F) << 6) | (p[3] & 0x3F);
+    }
+    return 0;
+}
+
+inline bool
+validateScalar(const uint8_t* p, const uint8_t* end) {
+    while( p < end ) {
+        // skip ASCII runs a word at a time
+        while( end - p >= 8 && isAscii8(reinterpret_cast<const char*>(p)) )
+            p	+= 8;
+        if( p == end )
+            break;
+
+        if( *p < 0x80 ) {
+            ++p;
+            continue;
+        }
+
+        size_t	len;
+        decodeOne(p, end, len);
+        if( !len )
+            return false;
+        p	+= len;
+    }
+    return true;
+}
+
+#if defined(__SSSE3__)
+//
+// John Keiser, Daniel Lemire, "Validating UTF-8 In Less Than One Instruction Per Byte",
+// Software: Practice and Experience 51 (5), 2021. Every error class is a bit, looked up from
+// the high nibble of the previous byte, its low nibble and the high nibble of the current byte;
+// the AND of the three lookups is non zero only where the two byte pattern is invalid.
+//
+struct Utf8Checker
+{
+    enum
+    {
+        TOO_SHORT	= 1 << 0,	// 11______ 0_______ or 11______ 11______
+        TOO_LONG	= 1 << 1,	// 0_______ 10______
+        OVERLONG_3	= 1 << 2,	// 11100000 100_____
+        TOO_LARGE	= 1 << 3,	// 11110100 1001____, 11110100 101_____, 11110101..11111111 1000____
+        SURROGATE	= 1 << 4,	// 11101101 101_____
+        OVERLONG_2	= 1 << 5,	// 1100000_ 10______
+        TOO_LARGE_1000	= 1 << 6,	// 11110101..11111111 1000____, the 4th byte of a too large sequence
+        OVERLONG_4	= 1 << 6,	// 11110000 1000____
+        TWO_CONTS	= 1 << 7,	// 10______ 10______
+        CARRY		= TOO_SHORT | TOO_LONG | TWO_CONTS
+    };
+
+    Utf8Checker()
+        : error(_mm_setzero_si128())
+        , prevInput(_mm_setzero_si128())
+        , prevIncomplete(_mm_setzero_si128())	{}
+
+    static __m128i
+    highNibbles(__m128i v) {
+        return _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0F));
+    }
+
+    static __m128i
+    specialCases(__m128i input, __m128i prev1) {
+        const __m128i	byte1HighTable	= _mm_setr_epi8(
+            // 0_______ ________ <ASCII in byte 1>
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+            // 10______ ________ <continuation in byte 1>
+            TWO_CONTS, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+            // 1100____ ________ <two byte lead in byte 1>
+            TOO_SHORT | OVERLONG_2,
+            // 1101____ ________ <two byte lead in byte 1>
+            TOO_SHORT,
+            // 1110____ ________ <three byte lead in byte 1>
+            TOO_SHORT | OVERLONG_3 | SURROGATE,
+            // 1111____ ________ <four+ byte lead in byte 1>
+            TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+
+        const __m128i	byte1LowTable	= _mm_setr_epi8(
+            // ____0000 ________
+            CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+            // ____0001 ________
+            CARRY | OVERLONG_2,
+            // ____001_ ________
+            CARRY,
+            CARRY,
+            // ____0100 ________
+            CARRY | TOO_LARGE,
+            // ____0101 ________
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            // ____011_ ________
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            // ____1___ ________
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            // ____1101 ________
+            CARRY | TOO_LARGE | TOO_LARGE_1000 | SURROGATE,
+            CARRY | TOO_LARGE | TOO_LARGE_1000,
+            CARRY | TOO_LARGE | TOO_LARGE_1000);
+
+        const __m128i	byte2HighTable	= _mm_setr_epi8(
+            // ________ 0_______ <ASCII in byte 2>
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT,
+            // ________ 1000____
+            char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE_1000 | OVERLONG_4),
+            // ________ 1001____
+            char(TOO_LONG | OVERLONG_2 | TWO_CONTS | OVERLONG_3 | TOO_LARGE),
+            // ________ 101_____
+            char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+            char(TOO_LONG | OVERLONG_2 | TWO_CONTS | SURROGATE | TOO_LARGE),
+            // ________ 11______
+            TOO_SHORT, TOO_SHORT, TOO_SHORT, TOO_SHORT);
+
+        __m128i	byte1High	= _mm_shuffle_epi8(byte1HighTable, highNibbles(prev1));
+        __m128i	byte1Low	= _mm_shuffle_epi8(byte1LowTable, _mm_and_si128(prev1, _mm_set1_epi8(0x0F)));
+        __m128i	byte2High	= _mm_shuffle_epi8(byte2HighTable, highNibbles(input));
+        return _mm_and_si128(_mm_and_si128(byte1High, byte1Low), byte2High);
+    }
+
+    static __m128i
+    multibyteLengths(__m128i input, __m128i prev, __m128i sc) {
+        __m128i	prev2		= _mm_alignr_epi8(input, prev, 16 - 2);
+        __m128i	prev3		= _mm_alignr_epi8(input, prev, 16 - 3);
+        // only 111_____ (resp. 1111____) keep their high bit after the saturating subtraction
+        __m128i	isThird		= _mm_subs_epu8(prev2, _mm_set1_epi8(char(0xE0 - 0x80)));
+        __m128i	isFourth	= _mm_subs_epu8(prev3, _mm_set1_epi8(char(0xF0 - 0x80)));
+        __m128i	must23		= _mm_and_si128(_mm_or_si128(isThird, isFourth), _mm_set1_epi8(char(0x80)));
+        return _mm_xor_si128(must23, sc);
+    }
+
+    static __m128i
+    isIncomplete(__m128i input) {
+        // a lead byte in the last 3 positions needs bytes from the next block
+        const __m128i	maxValue	= _mm_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, char(0xF0 - 1), char(0xE0 - 1), char(0xC0 - 1));
+        return _mm_subs_epu8(input, maxValue);
+    }
+
+    void
+    checkBlock(__m128i input) {
+        if( _mm_movemask_epi8(input) == 0 ) {
+            // ASCII block, only an unfinished sequence from the previous one can be wrong
+            error	= _mm_or_si128(error, prevIncomplete);
+        } else {
+            __m128i	prev1	= _mm_alignr_epi8(input, prevInput, 16 - 1);
+            __m128i	sc	= specialCases(input, prev1);
+            error		= _mm_or_si128(error, multibyteLengths(input, prevInput, sc));
+            prevIncomplete	= isIncomplete(input);
+        }
+        prevInput	= input;
+    }
+
+    bool
+    hasError() const {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(error, _mm_setzero_si128())) != 0xFFFF;
+    }
+
+    bool
+    finish() {
+        error	= _mm_or_si128(error, prevIncomplete);
+        return !hasError();
+    }
+
+    __m128i		error;
+    __m128i		prevInput;
+    __m128i		prevIncomplete;
+};
+#endif
+
+}	// namespace Detail
+
+///
+/// @param s the bytes
+/// @param len the number of bytes
+/// @return true if s[0, len) is well formed UTF-8 (no overlongs, surrogates or code points > U+10FFFF)
+///
+inline bool
+validateUtf8(const char* s, size_t len) {
+#if defined(__SSSE3__)
+    Detail::Utf8Checker	checker;
+    size_t	i	= 0;
+    for( ; i + 16 <= len; i += 16 ) {
+        checker.checkBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i)));
+
+        // bail out early on bad input, but not on every block
+        if( (i & 1023) == 1008 && checker.hasError() )
+            return false;
+    }
+
+    if( i < len ) {
+        // zero padding is ASCII, so it only flags sequences cut by the end of input
+        char	tail[16]	= {};
+        memcpy(tail, s + i, len - i);
+        checker.checkBlock(_mm_loadu_si128(reinterpret_cast<const __m128i*>(tail)));
+    }
+    return checker.finish();
+#else
+    const uint8_t*	p	= reinterpret_cast<const uint8_t*>(s);
+    const uint8_t*	end	= p + len;
+#if defined(__SSE2__)
+    while( end - p >= 16 ) {
+        __m128i	v	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int	mask	= _mm_movemask_epi8(v);
+        if( mask ) {
+            // validate up to the next ASCII byte after the non ASCII run, then resume block mode
+            p	+= __builtin_ctz(unsigned(mask));
+            size_t	l;
+            Detail::decodeOne(p, end, l);
+            if( !l )
+                return false;
+            p	+= l;
+        } else {
+            p	+= 16;
+        }
+    }
+#endif
+    return Detail::validateScalar(p, end);
+#endif
+}
+
+inline bool	validateUtf8(const StringView& s)	{	return validateUtf8(s.data(), s.size());	}
+
+///
+/// count the code points of valid UTF-8, which is the number of bytes that are not continuation bytes
+///
+inline size_t
+countCodePoints(const char* s, size_t len) {
+    size_t	count	= 0;
+    size_t	i	= 0;
+#if defined(__SSE2__)
+    // continuation bytes are 0x80..0xBF, i.e. < -64 as signed chars
+    const __m128i	threshold	= _mm_set1_epi8(-65);
+    for( ; i + 16 <= len; i += 16 ) {
+        __m128i	v	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        count	+= size_t(__builtin_popcount(unsigned(_mm_movemask_epi8(_mm_cmpgt_epi8(v, threshold)))));
+    }
+#endif
+    for( ; i < len; ++i )
+        count	+= (uint8_t(s[i]) & 0xC0) != 0x80;
+    return count;
+}
+
+inline size_t	countCodePoints(const StringView& s)	{	return countCodePoints(s.data(), s.size());	}
+
+///
+/// decode the code point at p and advance p past it. an invalid byte decodes as
+/// REPLACEMENT_CHARACTER and is skipped alone
+/// @param p the current position, p < end
+/// @param end the end of input
+/// @return the code point
+///
+inline uint32_t
+decodeUtf8(const char*& p, const char* end) {
+    size_t		len;
+    uint32_t	cp	= Detail::decodeOne(reinterpret_cast<const uint8_t*>(p), reinterpret_cast<const uint8_t*>(end), len);
+    if( !len ) {
+        ++p;
+        return REPLACEMENT_CHARACTER;
+    }
+    p	+= len;
+    return cp;
+}
+
+///
+/// encode cp into out
+/// @param out at least 4 bytes
+/// @return the number of bytes written, 0 for surrogates and values > U+10FFFF
+///
+inline size_t
+encodeUtf8(uint32_t cp, char* out) {
+    if( cp < 0x80 ) {
+        out[0]	= char(cp);
+        return 1;
+    } else if( cp < 0x800 ) {
+        out[0]	= char(0xC0 | (cp >> 6));
+        out[1]	= char(0x80 | (cp & 0x3F));
+        return 2;
+    } else if( cp < 0x10000 ) {
+        if( cp >= 0xD800 && cp <= 0xDFFF )
+            return 0;
+        out[0]	= char(0xE0 | (cp >> 12));
+        out[1]	= char(0x80 | ((cp >> 6) & 0x3F));
+        out[2]	= char(0x80 | (cp & 0x3F));
+        return 3;
+    } else if( cp <= 0x10FFFF ) {
+        out[0]	= char(0xF0 | (cp >> 18));
+        out[1]	= char(0x80 | ((cp >> 12) & 0x3F));
+        out[2]	= char(0x80 | ((cp >> 6) & 0x3F));
+        out[3]	= char(0x80 | (cp & 0x3F));
+        return 4;
+    }
+    return 0;
+}
+
+///
+/// iterate the code points of a UTF-8 run: for( uint32_t cp : Utf8View(str) ) ...
+///
+struct Utf8View
+{
+    struct Iterator
+    {
+        Iterator(const char* p, const char* end) : p(p), end(end)	{}
+
+        uint32_t
+        operator *() const {
+            const char*	q	= p;
+            return decodeUtf8(q, end);
+        }
+
+        Iterator&
+        operator++() {
+            decodeUtf8(p, end);
+            return *this;
+        }
+
+        bool	operator == (const Iterator& it) const	{ return p == it.p;	}
+        bool	operator != (const Iterator& it) const	{ return p != it.p;	}
+
+        const char*	position() const	{ return p;	}
+
+    private:
+        const char*	p;
+        const char*	end;
+    };
+
+    Utf8View(const StringView& s) : s(s)	{}
+
+    Iterator	begin() const	{ return Iterator(s.data(), s.data() + s.size());	}
+    Iterator	end() const	{ return Iterator(s.data() + s.size(), s.data() + s.size());	}
+
+private:
+    StringView	s;
+};
+
+///
+/// transcode UTF-8 to UTF-32
+/// @param out at least len code units
+/// @param outLen receives the number of code units written
+/// @return false if s is not valid UTF-8, out content is then unspecified
+///
+inline bool
+utf8ToUtf32(const char* s, size_t len, uint32_t* out, size_t& outLen) {
+    const uint8_t*	p	= reinterpret_cast<const uint8_t*>(s);
+    const uint8_t*	end	= p + len;
+    uint32_t*		o	= out;
+
+    while( p < end ) {
+#if defined(__SSE2__)
+        // widen ASCII blocks 16 bytes at a time
+        while( end - p >= 16 ) {
+            __m128i	v	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            if( _mm_movemask_epi8(v) )
+                break;
+            __m128i	zero	= _mm_setzero_si128();
+            __m128i	lo	= _mm_unpacklo_epi8(v, zero);
+            __m128i	hi	= _mm_unpackhi_epi8(v, zero);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o),      _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + 4),  _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + 8),  _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + 12), _mm_unpackhi_epi16(hi, zero));
+            p	+= 16;
+            o	+= 16;
+        }
+        if( p == end )
+            break;
+#endif
+        size_t		l;
+        uint32_t	cp	= Detail::decodeOne(p, end, l);
+        if( !l )
+            return false;
+        *o++	= cp;
+        p	+= l;
+    }
+
+    outLen	= size_t(o - out);
+    return true;
+}
+
+///
+/// transcode UTF-8 to UTF-16, code points above U+FFFF become surrogate pairs
+/// @param out at least len code units
+/// @param outLen receives the number of code units written
+/// @return false if s is not valid UTF-8, out content is then unspecified
+///
+inline bool
+utf8ToUtf16(const char* s, size_t len, uint16_t* out, size_t& outLen) {
+    const uint8_t*	p	= reinterpret_cast<const uint8_t*>(s);
+    const uint8_t*	end	= p + len;
+    uint16_t*		o	= out;
+
+    while( p < end ) {
+#if defined(__SSE2__)
+        while( end - p >= 16 ) {
+            __m128i	v	= _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            if( _mm_movemask_epi8(v) )
+                break;
+            __m128i	zero	= _mm_setzero_si128();
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o),     _mm_unpacklo_epi8(v, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(o + 8), _mm_unpackhi_epi8(v, zero));
+            p	+= 16;
+            o	+= 16;
+        }
+        if( p == end )
+            break;
+#endif
+        size_t		l;
+        uint32_t	cp	= Detail::decodeOne(p, end, l);
+        if( !l )
+            return false;
+        if( cp >= 0x10000 ) {
+            cp	-= 0x10000;
+            *o++	= uint16_t(0xD800 | (cp >> 10));
+            *o++	= uint16_t(0xDC00 | (cp & 0x3FF));
+        } else {
+            *o++	= uint16_t(cp);
+        }
+        p	+= l;
+    }
+
+    outLen	= size_t(o - out);
+    return true;
+}
+
+///
+/// transcode UTF-16 to UTF-8
+/// @param out at least 3 * len bytes
+/// @param outLen receives the number of bytes written
+/// @return false on unpaired surrogates
+///
+inline bool
+utf16ToUtf8(const uint16_t* s, size_t len, char* out, size_t& outLen) {
+    char*	o	= out;
+    for( size_t i = 0; i < len; ++i ) {
+        uint32_t	cp	= s[i];
+        if( cp < 0x80 ) {
+            *o++	= char(cp);
+            continue;
+        }
+
+        if( cp >= 0xD800 && cp <= 0xDBFF ) {
+            if( i + 1 == len || s[i + 1] < 0xDC00 || s[i + 1] > 0xDFFF )
+                return false;
+            cp	= 0x10000 + ((cp - 0xD800) << 10) + (s[++i] - 0xDC00);
+        } else if( cp >= 0xDC00 && cp <= 0xDFFF ) {
+            return false;
+        }
+        o	+= encodeUtf8(cp, o);
+    }
+
+    outLen	= size_t(o - out);
+    return true;
+}
+
+///
+/// transcode UTF-32 to UTF-8
+/// @param out at least 4 * len bytes
+/// @param outLen receives the number of bytes written
+/// @return false on surrogates or values above U+10FFFF
+///
+inline bool
+utf32ToUtf8(const uint32_t* s, size_t len, char* out, size_t& outLen) {
+    char*	o	= out;
+    for( size_t i = 0; i < len; ++i ) {
+        size_t	n	= encodeUtf8(s[i], o);
+        if( !n )
+            return false;
+        o	+= n;
+    }
+
+    outLen	= size_t(o - out);
+    return true;
+}
+
+//
+// Array / String front ends
+//
+
+inline bool
+utf8ToUtf32(const StringView& s, Array<uint32_t>& out) {
+    size_t	n	= 0;
+    out.resize(s.size());
+    bool	ok	= utf8ToUtf32(s.data(), s.size(), out.get(), n);
+    out.resize(ok ? n : 0);
+    return ok;
+}
+
+inline bool
+utf8ToUtf16(const StringView& s, Array<uint16_t>& out) {
+    size_t	n	= 0;
+    out.resize(s.size());
+    bool	ok	= utf8ToUtf16(s.data(), s.size(), out.get(), n);
+    out.resize(ok ? n : 0);
+    return ok;
+}
+
+inline bool
+utf16ToUtf8(const Array<uint16_t>& s, String& out) {
+    Array<char>	buf;
+    size_t	n	= 0;
+    buf.resize(s.size() * 3);
+    if( !utf16ToUtf8(s.get(), s.size(), buf.get(), n) )
+        return false;
+    out	= String(buf.get(), n);
+    return true;
+}
+
+inline bool
+utf32ToUtf8(const Array<uint32_t>& s, String& out) {
+    Array<char>	buf;
+    size_t	n	= 0;
+    buf.resize(s.size() * 4);
+    if( !utf32ToUtf8(s.get(), s.size(), buf.get(), n) )
+        return false;
+    out	= String(buf.get(), n);
+    return true;
+}
+
+}	// namespace BmCpp
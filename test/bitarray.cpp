@@ -0,0 +1,186 @@
+#include <bmcpp/bitarray.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::BitArray;
+using BmCpp::Array;
+using std::size_t;
+
+static uint32_t rng = 88172645u;
+
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+int testBits() {
+  BitArray b(130);
+  assert(b.size() == 130 && b.wordCount() == 3);
+  assert(b.none() && b.count() == 0);
+  assert(b.findFirst() == 130);
+
+  b.set(0);
+  b.set(63);
+  b.set(64);
+  b.set(129);
+  assert(b.test(0) && b.test(63) && b.test(64) && b.test(129) && !b.test(1));
+  assert(b.count() == 4 && b.any());
+  b.clear(63);
+  b.flip(1);
+  b.set(2, true);
+  b.set(0, false);
+  assert(!b.test(0) && b.test(1) && b.test(2) && !b.test(63));
+
+  assert(b.findFirst() == 1);
+  assert(b.findNext(3) == 64);
+  assert(b.findNext(65) == 129);
+  assert(b.findNext(130) == 130);
+
+  // bits past size() never show up
+  b.setAll();
+  assert(b.count() == 130);
+  b.flipAll();
+  assert(b.count() == 0);
+
+  BitArray ones(70, true);
+  assert(ones.count() == 70);
+  ones.resize(200, true);
+  assert(ones.count() == 200);
+  ones.resize(65);
+  assert(ones.count() == 65);
+  ones.resize(128);
+  assert(ones.count() == 65 && !ones.test(100));
+
+  // growing keeps the old bits, inside the same word and across words
+  BitArray grow(10);
+  grow.set(3);
+  grow.resize(20, true);
+  assert(grow.count() == 11 && !grow.test(0) && grow.test(3) && grow.test(10) && grow.test(19));
+  grow.resize(150, true);
+  assert(grow.count() == 141 && !grow.test(9) && grow.test(64) && grow.test(149));
+  BitArray empty;
+  empty.resize(64, true);
+  assert(empty.count() == 64);
+  return 0;
+}
+
+int testRankSelect() {
+  const size_t n = 100000;
+  BitArray b(n);
+  Array<size_t> positions;
+  for (size_t i = 0; i < n; ++i) {
+    if (next() % 7 == 0) {
+      b.set(i);
+      positions.pushBack(i);
+    }
+  }
+  assert(b.count() == positions.size());
+
+  size_t r = 0;
+  for (size_t i = 0; i <= n; i += 37) {
+    while (r < positions.size() && positions[r] < i)
+      ++r;
+    assert(b.rank(i) == r);
+  }
+  assert(b.rank(n) == positions.size());
+
+  for (size_t k = 0; k < positions.size(); k += 13)
+    assert(b.select(k) == positions[k]);
+  assert(b.select(positions.size()) == n);
+
+  // findNext walks every set bit
+  size_t k = 0;
+  for (size_t i = b.findFirst(); i < n; i = b.findNext(i + 1))
+    assert(i == positions[k++]);
+  assert(k == positions.size());
+  return 0;
+}
+
+// the word helpers (AVX2 and BMI2 when the build has them) agree with plain loops
+int testAgainstScalar() {
+  Array<uint64_t> words;
+  for (size_t i = 0; i < 3000; ++i) {
+    uint64_t w = (uint64_t(next()) << 32) | next();
+    uint64_t r = (uint64_t(next()) << 32) | next();
+    // sparse, dense and full words, plus a long full run that would overflow byte
+    // counters kept across too many vectors
+    unsigned kind = next() % 4;
+    if ((i >= 1000 && i < 1300) || kind == 0)
+      w = ~uint64_t(0);
+    else if (kind == 1)
+      w &= r;
+    else if (kind == 2)
+      w |= r;
+    words.pushBack(w);
+  }
+
+  for (size_t n = 0; n <= words.size(); n += n < 200 ? 1 : 97) {
+    size_t expected = 0;
+    for (size_t i = 0; i < n; ++i)
+      expected += size_t(__builtin_popcountll(words[i]));
+    assert(BmCpp::Detail::popcountWords(words.get(), n) == expected);
+    // unaligned starts
+    if (n > 3)
+      assert(BmCpp::Detail::popcountWords(words.get() + 3, n - 3) ==
+             expected - size_t(__builtin_popcountll(words[0]) + __builtin_popcountll(words[1]) + __builtin_popcountll(words[2])));
+  }
+
+  for (size_t i = 0; i < 200; ++i) {
+    uint64_t w = words[i];
+    unsigned k = 0;
+    for (unsigned bit = 0; bit < 64; ++bit)
+      if ((w >> bit) & 1)
+        assert(BmCpp::Detail::selectInWord(w, k++) == bit);
+  }
+  return 0;
+}
+
+int testBulk() {
+  const size_t n = 10007;
+  BitArray a(n), b(n);
+  Array<uint8_t> ra, rb;
+  for (size_t i = 0; i < n; ++i) {
+    uint8_t x = uint8_t(next() & 1), y = uint8_t(next() & 1);
+    ra.pushBack(x);
+    rb.pushBack(y);
+    a.set(i, x != 0);
+    b.set(i, y != 0);
+  }
+
+  BitArray o(a), x(a), an(a), nd(a);
+  a &= b;
+  o |= b;
+  x ^= b;
+  an.andNot(b);
+  size_t ca = 0, co = 0, cx = 0, cn = 0;
+  for (size_t i = 0; i < n; ++i) {
+    assert(a.test(i) == (ra[i] && rb[i]));
+    assert(o.test(i) == (ra[i] || rb[i]));
+    assert(x.test(i) == (ra[i] != rb[i]));
+    assert(an.test(i) == (ra[i] && !rb[i]));
+    ca += ra[i] && rb[i];
+    co += ra[i] || rb[i];
+    cx += ra[i] != rb[i];
+    cn += ra[i] && !rb[i];
+  }
+  assert(a.count() == ca && o.count() == co && x.count() == cx && an.count() == cn);
+
+  nd ^= nd;
+  assert(nd.none());
+  assert(a != o);
+  BitArray moved(BmCpp::move(o));
+  assert(moved.count() == co && o.size() == 0);
+  return 0;
+}
+
+int main() {
+  int r = testBits();
+  r |= testRankSelect();
+  r |= testAgainstScalar();
+  r |= testBulk();
+  return r;
+}
@@ -0,0 +1,243 @@
+#include <bmcpp/btree.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::BTreeMap;
+using BmCpp::Array;
+using std::size_t;
+
+static uint32_t rng = 2463534242u;
+
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+enum { UNIVERSE = 5000 };
+
+// walks the map in both directions and checks it against the reference
+template<typename Map>
+void check(const Map& m, const int* ref) {
+  size_t n = 0;
+  int prev = -1;
+  for (typename Map::Iterator it = m.begin(); it != m.end(); ++it) {
+    assert(it.key() > prev);
+    assert(ref[it.key()] == it.value());
+    prev = it.key();
+    ++n;
+  }
+  assert(n == m.count());
+  size_t expected = 0;
+  for (int k = 0; k < UNIVERSE; ++k)
+    expected += ref[k] >= 0;
+  assert(n == expected);
+}
+
+int testRandom() {
+  BTreeMap<int, int> m;
+  int ref[UNIVERSE];
+  for (int k = 0; k < UNIVERSE; ++k)
+    ref[k] = -1;
+
+  for (int round = 0; round < 60000; ++round) {
+    int k = int(next() % UNIVERSE);
+    // phases that grow, then shrink the tree
+    bool grow = (round / 10000) % 2 == 0;
+    if (next() % 4 != 0 ? grow : !grow) {
+      int v = int(next() % 1000);
+      int* p = m.set(k, v);
+      assert(*p == v);
+      ref[k] = v;
+    } else {
+      assert(m.remove(k) == (ref[k] >= 0));
+      ref[k] = -1;
+    }
+    if (round % 5000 == 0)
+      check(m, ref);
+  }
+  check(m, ref);
+
+  for (int k = 0; k < UNIVERSE; ++k) {
+    int* p = m.find(k);
+    assert(ref[k] < 0 ? p == nullptr : (p && *p == ref[k]));
+  }
+
+  // drain completely
+  for (int k = 0; k < UNIVERSE; ++k)
+    m.remove(k);
+  assert(m.count() == 0 && m.begin() == m.end());
+  assert(m.find(3) == nullptr && !m.remove(3));
+  m.set(3, 4);
+  assert(*m.find(3) == 4);
+  return 0;
+}
+
+int testBounds() {
+  BTreeMap<int, int> m;
+  for (int k = 0; k < 3000; k += 3)
+    m.set(k, k / 3);
+
+  for (int q = -2; q < 3003; ++q) {
+    BTreeMap<int, int>::Iterator lo = m.lowerBound(q);
+    BTreeMap<int, int>::Iterator hi = m.upperBound(q);
+    int expectLo = (q <= 0) ? 0 : (q + 2) / 3 * 3;
+    int expectHi = (q < 0) ? 0 : (q / 3 + 1) * 3;
+    assert(expectLo >= 3000 ? lo == m.end() : lo.key() == expectLo);
+    assert(expectHi >= 3000 ? hi == m.end() : hi.key() == expectHi);
+  }
+
+  // range scan [100, 200)
+  int seen = 0, last = -1;
+  m.range(100, 200, [&seen, &last](const int& k, const int& v) {
+    assert(k >= 100 && k < 200 && k > last && v == k / 3);
+    last = k;
+    ++seen;
+  });
+  assert(seen == 33);
+
+  // walking backwards from the end of a range
+  BTreeMap<int, int>::Iterator it = m.lowerBound(1500);
+  --it;
+  assert(it.key() == 1497);
+
+  // the last key <= q, also when upperBound(q) is end()
+  for (int q = 0; q < 3100; q += 7) {
+    BTreeMap<int, int>::Iterator floor = m.upperBound(q);
+    --floor;
+    assert(floor.key() == (q < 2997 ? q / 3 * 3 : 2997));
+  }
+  BTreeMap<int, int>::Iterator back = m.end();
+  int expect = 2997;
+  while (back != m.begin()) {
+    --back;
+    assert(back.key() == expect);
+    expect -= 3;
+  }
+  assert(expect == -3);
+  return 0;
+}
+
+int testBulkLoad() {
+  const size_t sizes[] = { 0, 1, 5, 31, 32, 33, 1000, 54321 };
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    size_t n = sizes[s];
+    Array<uint64_t> keys;
+    Array<double> values;
+    for (size_t i = 0; i < n; ++i) {
+      keys.pushBack(uint64_t(i) * 7 + 1);
+      values.pushBack(double(i));
+    }
+
+    BTreeMap<uint64_t, double> m;
+    m.set(99999999, 1.0);	// replaced by the load
+    m.bulkLoad(keys.get(), values.get(), n);
+    assert(m.count() == n);
+    assert(m.find(99999999) == nullptr);
+
+    size_t i = 0;
+    for (BTreeMap<uint64_t, double>::Iterator it = m.begin(); it != m.end(); ++it, ++i)
+      assert(it.key() == keys[i] && it.value() == values[i]);
+    assert(i == n);
+
+    // a loaded tree keeps working
+    for (size_t j = 0; j < n; j += 2)
+      assert(m.remove(keys[j]));
+    for (size_t j = 0; j < n; ++j) {
+      double* v = m.find(keys[j]);
+      assert(j % 2 == 0 ? v == nullptr : *v == values[j]);
+    }
+    for (size_t j = 0; j < n; j += 2)
+      m.set(keys[j] + 1, 0.5);
+    assert(m.count() == n);
+    uint64_t prev = 0;
+    for (BTreeMap<uint64_t, double>::Iterator it = m.begin(); it != m.end(); ++it) {
+      assert(it.key() > prev);
+      prev = it.key();
+    }
+  }
+  return 0;
+}
+
+struct Greater {
+  bool operator()(int a, int b) const { return a > b; }
+};
+
+int testComparator() {
+  BTreeMap<int, int, Greater> m;
+  for (int k = 0; k < 500; ++k)
+    m.set(k, k);
+  int expect = 499;
+  for (BTreeMap<int, int, Greater>::Iterator it = m.begin(); it != m.end(); ++it)
+    assert(it.key() == expect--);
+  assert(m.lowerBound(250).key() == 250);
+  assert(m.upperBound(250).key() == 249);
+
+  BTreeMap<int, int, Greater> moved(BmCpp::move(m));
+  assert(moved.count() == 500 && m.count() == 0);
+  return 0;
+}
+
+// copy only, so a moved-from slot keeps what it held; live counts the engaged ones
+struct Counted {
+  Counted() : v(-1) {}
+  explicit Counted(int v) : v(v) { ++live; }
+  Counted(const Counted& o) : v(o.v) {
+    if (v >= 0)
+      ++live;
+  }
+  Counted& operator=(const Counted& o) {
+    if (v >= 0)
+      --live;
+    v = o.v;
+    if (v >= 0)
+      ++live;
+    return *this;
+  }
+  ~Counted() {
+    if (v >= 0)
+      --live;
+  }
+  int v;
+  static int live;
+};
+int Counted::live = 0;
+
+int testReleasesErased() {
+  {
+    // inner nodes hold copies of separator keys, so only the values are counted
+    BTreeMap<int, Counted> m;
+    for (int k = 0; k < 3000; ++k)
+      m.set(k, Counted(k));
+    assert(Counted::live == 3000);
+
+    // erases from the ends and the middle of leaves, with borrows and merges on the way
+    for (int k = 0; k < 3000; k += 3)
+      assert(m.remove(k));
+    assert(Counted::live == int(m.count()));
+    for (int k = 2999; k >= 0; --k)
+      if (k % 3 != 0 && k % 7 != 0)
+        assert(m.remove(k));
+    assert(Counted::live == int(m.count()));
+    for (int k = 0; k < 3000; ++k)
+      m.remove(k);
+    assert(m.count() == 0 && Counted::live == 0);
+
+    for (int k = 0; k < 500; ++k)
+      m.set(k, Counted(k));
+  }
+  assert(Counted::live == 0);
+  return 0;
+}
+
+int main() {
+  int r = testRandom();
+  r |= testBounds();
+  r |= testBulkLoad();
+  r |= testComparator();
+  r |= testReleasesErased();
+  return r;
+}
@@ -0,0 +1,207 @@
+#include <bmcpp/epoch.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::EpochDomain;
+using BmCpp::EpochGuard;
+using BmCpp::AtomicObjectPtr;
+using BmCpp::Object;
+using BmCpp::ObjectPtr;
+using std::size_t;
+
+static const size_t READERS = 4;
+static const uint32_t UPDATES = 20000;
+
+static std::atomic<int> alive(0);
+
+struct Config : Object {
+  explicit Config(uint32_t version) : version(version), check(~version) { alive.fetch_add(1); }
+  ~Config() override {
+    check = 0;
+    alive.fetch_sub(1);
+  }
+  uint32_t version;
+  uint32_t check;
+};
+
+struct Shared {
+  EpochDomain domain;
+  std::atomic<Config *> current;
+  std::atomic<bool> done;
+};
+
+static void *reader(void *arg) {
+  Shared *s = static_cast<Shared *>(arg);
+  EpochDomain::Participant *p = s->domain.attach();
+  assert(p != nullptr);
+
+  uint32_t last = 0;
+  while (!s->done.load()) {
+    EpochGuard guard(s->domain, p);
+    Config *c = s->current.load(std::memory_order_acquire);
+    // the object cannot be destroyed while the guard is held
+    assert(c->check == ~c->version);
+    assert(c->version >= last);
+    last = c->version;
+  }
+  s->domain.detach(p);
+  return nullptr;
+}
+
+int testDomain() {
+  Shared s;
+  s.done.store(false);
+  Config *first = new Config(0);
+  first->grab();
+  s.current.store(first);
+
+  pthread_t threads[READERS];
+  for (size_t i = 0; i < READERS; ++i)
+    pthread_create(&threads[i], nullptr, reader, &s);
+
+  EpochDomain::Participant *writer = s.domain.attach();
+  for (uint32_t v = 1; v <= UPDATES; ++v) {
+    Config *next = new Config(v);
+    next->grab();
+    Config *old = s.current.exchange(next, std::memory_order_acq_rel);
+    s.domain.retire(writer, old);
+    if ((v & 255) == 0)
+      sched_yield();
+  }
+
+  s.done.store(true);
+  for (size_t i = 0; i < READERS; ++i)
+    pthread_join(threads[i], nullptr);
+
+  s.domain.synchronize(writer);
+  assert(alive.load() == 1);
+
+  // ObjectPtr overload: the domain takes the pointer's reference
+  ObjectPtr<Config> last = ObjectPtr<Config>::adopt(s.current.exchange(nullptr));
+  s.domain.retire(writer, static_cast<ObjectPtr<Config> &&>(last));
+  assert(!last && alive.load() == 1);
+  s.domain.synchronize(writer);
+  assert(alive.load() == 0);
+  s.domain.detach(writer);
+  return 0;
+}
+
+int testNesting() {
+  EpochDomain domain(2);
+  EpochDomain::Participant *a = domain.attach();
+  EpochDomain::Participant *b = domain.attach();
+  assert(a && b && !domain.attach());
+
+  {
+    EpochGuard outer(domain, a);
+    EpochGuard inner(domain, a);
+    uint64_t e = domain.epoch();
+    // a pins e: the epoch can move once, never twice
+    domain.tryAdvance();
+    assert(!domain.tryAdvance() && domain.epoch() <= e + 1);
+  }
+  assert(domain.tryAdvance());
+
+  Config *c = new Config(1);
+  c->grab();
+  {
+    EpochGuard g(domain, a);
+    domain.retire(b, c);
+    domain.collect(b);
+    assert(alive.load() == 1);
+  }
+  domain.synchronize(b);
+  assert(alive.load() == 0);
+
+  // objects left in a slot are released by the domain
+  Config *d = new Config(2);
+  d->grab();
+  domain.retire(a, d);
+  domain.detach(a);
+  domain.detach(b);
+  return 0;
+}
+
+struct Snapshot {
+  EpochDomain domain;
+  AtomicObjectPtr<Config> table;
+  std::atomic<bool> done;
+  Snapshot() : table(domain, ObjectPtr<Config>(new Config(0))), done(false) {}
+};
+
+static void *snapshotReader(void *arg) {
+  Snapshot *s = static_cast<Snapshot *>(arg);
+  EpochDomain::Participant *p = s->domain.attach();
+
+  uint32_t last = 0;
+  for (size_t i = 0; !s->done.load(); ++i) {
+    if (i & 1) {
+      ObjectPtr<Config> c = s->table.load(p);
+      assert(c->check == ~c->version && c->version >= last);
+      last = c->version;
+    } else {
+      EpochGuard guard(s->domain, p);
+      Config *c = s->table.read(guard);
+      assert(c->check == ~c->version && c->version >= last);
+      last = c->version;
+    }
+  }
+  s->domain.detach(p);
+  return nullptr;
+}
+
+int testAtomicObjectPtr() {
+  {
+    Snapshot s;
+    pthread_t threads[READERS];
+    for (size_t i = 0; i < READERS; ++i)
+      pthread_create(&threads[i], nullptr, snapshotReader, &s);
+
+    EpochDomain::Participant *writer = s.domain.attach();
+    for (uint32_t v = 1; v <= UPDATES; ++v) {
+      switch (v % 3) {
+      case 0:
+        s.table.store(writer, ObjectPtr<Config>(new Config(v)));
+        break;
+      case 1: {
+        ObjectPtr<Config> old = s.table.exchange(writer, ObjectPtr<Config>(new Config(v)));
+        assert(old->version == v - 1);
+        break;
+      }
+      default: {
+        ObjectPtr<Config> expected;
+        // the first attempt fails and reports the current snapshot
+        assert(!s.table.compareExchange(writer, expected, ObjectPtr<Config>(new Config(v))));
+        assert(expected->version == v - 1);
+        assert(s.table.compareExchange(writer, expected, ObjectPtr<Config>(new Config(v))));
+        break;
+      }
+      }
+      if ((v & 255) == 0)
+        sched_yield();
+    }
+
+    s.done.store(true);
+    for (size_t i = 0; i < READERS; ++i)
+      pthread_join(threads[i], nullptr);
+
+    s.domain.synchronize(writer);
+    assert(alive.load() == 1);
+    assert(s.table.load(writer)->version == UPDATES);
+    s.domain.detach(writer);
+  }
+  assert(alive.load() == 0);
+  return 0;
+}
+
+int main(void) {
+  int r = testDomain()
+    | testNesting()
+    | testAtomicObjectPtr();
+  assert(alive.load() == 0);
+  return r;
+}
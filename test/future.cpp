@@ -0,0 +1,138 @@
+#include <bmcpp/future.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::Array;
+using BmCpp::Future;
+using BmCpp::Promise;
+using BmCpp::Result;
+using BmCpp::Unit;
+using BmCpp::ThreadPool;
+using BmCpp::PoolExecutor;
+using BmCpp::whenAll;
+using BmCpp::whenAny;
+using BmCpp::makeReadyFuture;
+using BmCpp::makeErrorFuture;
+using std::size_t;
+
+enum { E_TIMEOUT = 42 };
+
+int testPromise() {
+  Promise<int> p;
+  Future<int> f = p.future();
+  assert(f.valid() && !f.isReady());
+  p.setValue(7);
+  assert(f.isReady());
+  assert(f.get().ok() && f.get().value() == 7);
+
+  Future<int> e = makeErrorFuture<int>(E_TIMEOUT);
+  assert(!e.get().ok() && e.get().error() == E_TIMEOUT);
+
+  Future<int> broken;
+  {
+    Promise<int> q;
+    broken = q.future();
+  }
+  assert(broken.get().error() == BmCpp::BROKEN_PROMISE);
+
+  Future<int> r = makeReadyFuture(3);
+  assert(r.get().value() == 3);
+  return 0;
+}
+
+int testThen() {
+  Promise<int> p;
+  int seen = 0;
+
+  // registered before the value arrives, run by setValue
+  Future<int> doubled = p.future().then([](const Result<int>& r) { return r.value() * 2; });
+  Future<Unit> done = doubled.then([&seen](const Result<int>& r) { seen = r.value(); });
+  // a continuation returning a Result can fail the chain
+  Future<int> checked = doubled.then([](const Result<int>& r) {
+    return r.value() >= 10 ? Result<int>(r.value()) : Result<int>::failure(E_TIMEOUT);
+  });
+  assert(!done.isReady());
+
+  p.setValue(5);
+  assert(done.isReady() && seen == 10);
+  assert(checked.get().value() == 10);
+
+  // already ready: runs on the caller
+  Future<int> late = doubled.then([](const Result<int>& r) { return r.value() + 1; });
+  assert(late.get().value() == 11);
+
+  // errors travel down the chain as values
+  Future<int> failed = makeErrorFuture<int>(E_TIMEOUT)
+    .then([](const Result<int>& r) { return r.ok() ? Result<int>(r.value()) : Result<int>::failure(r.error()); })
+    .then([](const Result<int>& r) { return r; });
+  assert(failed.get().error() == E_TIMEOUT);
+  return 0;
+}
+
+int testExecutor() {
+  ThreadPool pool(3);
+  PoolExecutor executor(pool);
+
+  const size_t n = 1000;
+  Array<Promise<uint64_t>> promises;
+  Array<Future<uint64_t>> results;
+  for (size_t i = 0; i < n; ++i) {
+    promises.pushBack(Promise<uint64_t>());
+    results.pushBack(promises[i].future().then(executor, [](const Result<uint64_t>& r) {
+      return r.value() * r.value();
+    }));
+  }
+
+  // fulfil from the pool, continuations hop back onto it
+  for (size_t i = 0; i < n; ++i) {
+    Promise<uint64_t>* p = &promises[i];
+    pool.submit([p, i]() { p->setValue(i); });
+  }
+
+  Future<Array<Result<uint64_t>>> all = whenAll(results);
+  const Array<Result<uint64_t>>& values = all.get().value();
+  assert(values.size() == n);
+  for (size_t i = 0; i < n; ++i)
+    assert(values[i].ok() && values[i].value() == i * i);
+  return 0;
+}
+
+int testCombinators() {
+  Array<Promise<int>> promises;
+  Array<Future<int>> futures;
+  for (int i = 0; i < 4; ++i) {
+    promises.pushBack(Promise<int>());
+    futures.pushBack(promises[i].future());
+  }
+
+  Future<size_t> any = whenAny(futures);
+  Future<Array<Result<int>>> all = whenAll(futures);
+  assert(!any.isReady());
+
+  promises[2].setError(E_TIMEOUT);
+  assert(any.isReady() && any.get().value() == 2);
+  promises[0].setValue(0);
+  promises[3].setValue(3);
+  assert(!all.isReady());
+  promises[1].setValue(1);
+  assert(all.isReady());
+
+  const Array<Result<int>>& r = all.get().value();
+  assert(r[0].value() == 0 && r[1].value() == 1 && r[3].value() == 3);
+  assert(r[2].error() == E_TIMEOUT);
+
+  Array<Future<int>> none;
+  assert(whenAll(none).get().value().size() == 0);
+  assert(whenAny(none).get().error() == BmCpp::BROKEN_PROMISE);
+  return 0;
+}
+
+int main() {
+  int r = testPromise();
+  r |= testThen();
+  r |= testExecutor();
+  r |= testCombinators();
+  return r;
+}
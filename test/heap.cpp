@@ -0,0 +1,106 @@
+#include <bmcpp/heap.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::PriorityQueue;
+using BmCpp::Array;
+using std::size_t;
+
+static uint32_t rng = 12345u;
+
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+struct Greater {
+  bool operator()(int a, int b) const { return a > b; }
+};
+
+int testOrder() {
+  PriorityQueue<int> q;
+  assert(q.empty());
+  for (int i = 0; i < 10000; ++i)
+    q.push(int(next() % 100000));
+  assert(q.size() == 10000);
+
+  int prev = -1;
+  while (!q.empty()) {
+    int v = q.take();
+    assert(v >= prev);
+    prev = v;
+  }
+
+  PriorityQueue<int, Greater> max;
+  for (int i = 0; i < 100; ++i)
+    max.push(i);
+  assert(max.top() == 99);
+  max.pop();
+  assert(max.top() == 98);
+  return 0;
+}
+
+int testHandles() {
+  enum { N = 5000 };
+  PriorityQueue<uint32_t> q;
+  PriorityQueue<uint32_t>::Handle handles[N];
+  uint32_t keys[N];
+  bool live[N];
+  for (int i = 0; i < N; ++i) {
+    keys[i] = next() % 1000000 + 1000000;
+    handles[i] = q.push(keys[i]);
+    live[i] = true;
+  }
+
+  for (int round = 0; round < 20000; ++round) {
+    int i = int(next() % N);
+    if (!live[i])
+      continue;
+    assert(q.contains(handles[i]) && q.get(handles[i]) == keys[i]);
+    switch (next() % 3) {
+    case 0:
+      keys[i] -= next() % 1000;
+      q.decreaseKey(handles[i], keys[i]);
+      break;
+    case 1:
+      keys[i] = next() % 2000000;
+      q.update(handles[i], keys[i]);
+      break;
+    default:
+      q.erase(handles[i]);
+      live[i] = false;
+      break;
+    }
+  }
+
+  // drain: the top is always the smallest live key
+  size_t remaining = 0;
+  for (int i = 0; i < N; ++i)
+    remaining += live[i];
+  assert(q.size() == remaining);
+  uint32_t prev = 0;
+  while (!q.empty()) {
+    PriorityQueue<uint32_t>::Handle h = q.topHandle();
+    uint32_t v = q.top();
+    assert(v >= prev);
+    prev = v;
+    q.pop();
+    assert(!q.contains(h));
+  }
+
+  // freed handles are reused
+  PriorityQueue<uint32_t>::Handle a = q.push(1);
+  q.pop();
+  assert(q.push(2) == a);
+  return 0;
+}
+
+int main() {
+  int r = testOrder();
+  r |= testHandles();
+  return r;
+}
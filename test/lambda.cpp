@@ -0,0 +1,130 @@
+#include <bmcpp/lambda.hpp>
+#include <bmcpp/object.hpp>
+#include <bmcpp/hashmap.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::Lambda;
+using BmCpp::FunctionRef;
+using BmCpp::HashMap;
+using BmCpp::Object;
+using BmCpp::ObjectPtr;
+using BmCpp::move;
+using std::size_t;
+
+static int alive = 0;
+
+struct Counted : Object {
+  Counted() { ++alive; }
+  ~Counted() override { --alive; }
+};
+
+struct Big {
+  uint64_t values[16];
+};
+
+int testInline() {
+  int base = 40;
+  Lambda<int(int)> add([base](int x) { return base + x; });
+  assert(add(2) == 42);
+
+  // mutable state survives moves
+  int counter = 0;
+  Lambda<int()> next([counter]() mutable { return ++counter; });
+  assert(next() == 1);
+  Lambda<int()> moved(move(next));
+  assert(!next && moved() == 2);
+
+  Lambda<int()> assigned;
+  assert(!assigned);
+  assigned = move(moved);
+  assert(assigned() == 3);
+  assigned = []() { return 7; };
+  assert(assigned() == 7);
+  return 0;
+}
+
+int testHeap() {
+  Big big;
+  for (size_t i = 0; i < 16; ++i)
+    big.values[i] = i;
+
+  Lambda<uint64_t(size_t)> at([big](size_t i) { return big.values[i]; });
+  assert(at(15) == 15);
+  Lambda<uint64_t(size_t)> other(move(at));
+  assert(!at && other(3) == 3);
+  return 0;
+}
+
+int testCaptures() {
+  {
+    ObjectPtr<Counted> p(new Counted());
+    Lambda<size_t()> small([p]() { return p->getRefCount(); });
+    assert(small() == 2);
+
+    Big big;
+    big.values[0] = 1;
+    Lambda<size_t()> large([p, big]() { return p->getRefCount() + big.values[0]; });
+    assert(large() == 4);
+
+    Lambda<size_t()> taken(move(small));
+    assert(taken() == 3);
+    p.reset();
+    taken.reset();
+    assert(alive == 1);
+  }
+  assert(alive == 0);
+
+  // reference arguments are passed through untouched
+  Lambda<void(int &)> inc([](int &v) { ++v; });
+  int v = 1;
+  inc(v);
+  assert(v == 2);
+  return 0;
+}
+
+static int twice(int v) { return 2 * v; }
+
+static int apply(FunctionRef<int(int)> f, int v) { return f(v); }
+
+int testFunctionRef() {
+  int calls = 0;
+  auto counting = [&calls](int v) { ++calls; return v + 1; };
+  assert(apply(counting, 1) == 2 && calls == 1);
+  assert(apply(twice, 21) == 42);
+  assert(apply(&twice, 4) == 8);
+
+  Lambda<int(int)> owned([](int v) { return -v; });
+  assert(apply(owned, 5) == -5);
+
+  FunctionRef<int(int)> ref(counting);
+  FunctionRef<int(int)> copy(ref);
+  assert(copy(10) == 11 && calls == 2);
+
+  HashMap<uint32_t, uint32_t> map;
+  for (uint32_t i = 0; i < 100; ++i)
+    map.set(i, i * 3);
+  map.foreach([](const uint32_t &k, uint32_t *v) { *v += k; });
+  uint64_t sum = 0;
+  const HashMap<uint32_t, uint32_t> &cmap = map;
+  cmap.foreach([&sum](uint32_t k, uint32_t v) { assert(v == 4 * k); sum += v; });
+  assert(sum == 4 * 99 * 100 / 2);
+
+  // a void FunctionRef takes callables that return something and drops the result
+  FunctionRef<void(int)> discard(counting);
+  discard(1);
+  assert(calls == 3);
+  size_t visited = 0;
+  cmap.foreach([&visited](uint32_t, uint32_t) { return ++visited; });
+  assert(visited == 100);
+  return 0;
+}
+
+int main(void) {
+  return testInline()
+    | testHeap()
+    | testCaptures()
+    | testFunctionRef();
+}
@@ -5,6 +5,9 @@
 #include <cassert>
 
 using BmCpp::List;
+using BmCpp::IntrusiveList;
+using BmCpp::ListHook;
+using BmCpp::ChunkedList;
 using std::uint32_t;
 using std::size_t;
 
@@ -41,7 +44,233 @@ int testPushFront() {
   return 0;
 }
 
+struct Timer {
+  Timer(uint32_t id) : id(id) {}
+  uint32_t id;
+  ListHook byDeadline;
+  ListHook byOwner;
+};
+
+int testIntrusive() {
+  Timer timers[] = { Timer(0), Timer(1), Timer(2), Timer(3) };
+  IntrusiveList<Timer, &Timer::byDeadline> deadlines;
+  IntrusiveList<Timer, &Timer::byOwner> owned;
+
+  for (auto &t : timers) {
+    deadlines.push_back(t);
+    owned.push_front(t);
+  }
+  assert(deadlines.size() == 4 && owned.size() == 4);
+  assert(deadlines.front().id == 0 && owned.front().id == 3);
+
+  // O(1) erase from one list only needs the object
+  deadlines.erase(timers[1]);
+  assert(!timers[1].byDeadline.isLinked());
+  assert(timers[1].byOwner.isLinked());
+
+  uint32_t expected[] = { 0, 2, 3 };
+  size_t i = 0;
+  for (auto &t : deadlines) {
+    assert(t.id == expected[i]);
+    ++i;
+  }
+  assert(i == 3);
+
+  deadlines.insert(deadlines.iteratorTo(timers[2]), timers[1]);
+  assert(deadlines.size() == 4);
+  i = 0;
+  for (auto it = deadlines.cbegin(); it != deadlines.cend(); ++it, ++i)
+    assert(it->id == i);
+
+  deadlines.pop_front();
+  deadlines.pop_back();
+  assert(deadlines.front().id == 1 && deadlines.back().id == 2);
+
+  deadlines.clear();
+  owned.clear();
+  assert(deadlines.empty() && !timers[2].byDeadline.isLinked());
+
+  return 0;
+}
+
+int testChunked() {
+  ChunkedList<uint32_t, 4> list;
+
+  // grow at both ends across several blocks
+  for (uint32_t i = 0; i < 10; ++i) {
+    list.push_back(10 + i);
+    list.push_front(9 - i);
+  }
+  assert(list.size() == 20);
+  assert(list.front() == 0 && list.back() == 19);
+
+  uint32_t count = 0;
+  for (auto &e : list) {
+    assert(e == count);
+    count++;
+  }
+  assert(count == 20);
+  assert(list[7] == 7 && list[13] == 13);
+
+  auto it = list.end();
+  for (uint32_t i = 20; i-- > 0;) {
+    --it;
+    assert(*it == i);
+  }
+  assert(it == list.begin());
+
+  size_t total = 0;
+  list.foreachChunk([&total](uint32_t* items, size_t n) {
+    for (size_t i = 0; i < n; ++i)
+      assert(items[i] == total + i);
+    total += n;
+  });
+  assert(total == 20);
+
+  // FIFO use
+  for (uint32_t i = 0; i < 20; ++i) {
+    assert(list.front() == i);
+    list.pop_front();
+    list.push_back(20 + i);
+  }
+  for (uint32_t i = 0; i < 10; ++i)
+    list.pop_back();
+  assert(list.size() == 10 && list.front() == 20 && list.back() == 29);
+
+  ChunkedList<uint32_t, 4> copy(list);
+  list.clear();
+  assert(list.empty() && list.begin() == list.end());
+  assert(copy.size() == 10 && copy[9] == 29);
+
+  return 0;
+}
+
+template <typename T>
+static bool isSorted(const List<T> &list, size_t n) {
+  size_t count = 0;
+  auto prev = list.cbegin();
+  for (auto it = list.cbegin(); it != list.cend(); ++it, ++count)
+    if (it != list.cbegin() && *it < *prev++)
+      return false;
+
+  // walk back too, prev links must have been rebuilt
+  size_t back = 0;
+  for (auto it = list.last(); it != list.end(); --it)
+    ++back;
+  return count == n && back == n && list.size() == n;
+}
+
+struct Desc {
+  bool operator()(uint32_t a, uint32_t b) const { return a > b; }
+};
+
+int testSpliceMergeSort() {
+  List<uint32_t> a, b;
+  for (uint32_t i = 0; i < 5; ++i) {
+    a.push_back(i);
+    b.push_back(10 + i);
+  }
+
+  // whole list, then a single node back, then a range
+  a.splice(a.end(), b);
+  assert(a.size() == 10 && b.empty());
+  b.splice(b.end(), a, a.begin());
+  assert(a.size() == 9 && b.size() == 1 && *b.begin() == 0 && a.front() == 1);
+
+  auto first = a.begin();
+  auto last = a.begin();
+  for (int i = 0; i < 3; ++i) ++last;
+  b.splice(b.begin(), a, first, last);
+  assert(b.size() == 4 && a.size() == 6);
+  uint32_t expectedB[] = { 1, 2, 3, 0 };
+  size_t i = 0;
+  for (auto &e : b) assert(e == expectedB[i++]);
+
+  // pseudo random values, sorted then merged
+  List<uint32_t> c, d;
+  uint32_t x = 12345;
+  for (size_t n = 0; n < 1000; ++n) {
+    x = x * 1103515245u + 12345u;
+    c.push_back((x >> 16) % 500);
+    d.push_front((x >> 8) % 700);
+  }
+  c.sort();
+  d.sort();
+  assert(isSorted(c, 1000) && isSorted(d, 1000));
+  c.merge(d);
+  assert(d.empty() && isSorted(c, 2000));
+
+  c.sort(Desc());
+  uint32_t prev = c.front();
+  for (auto &e : c) {
+    assert(e <= prev);
+    prev = e;
+  }
+
+  return 0;
+}
+
+int testBulk() {
+  const size_t n = 5000;  // spans several node batches
+  static uint32_t values[n];
+  for (size_t i = 0; i < n; ++i) values[i] = uint32_t(i);
+
+  List<uint32_t> list(values, n);
+  assert(list.size() == n);
+  size_t count = 0;
+  for (auto &e : list) assert(e == count++);
+
+  // batch nodes can be erased, mixed with single nodes and moved to other lists
+  list.erase(list.begin());
+  list.pop_back();
+  list.push_front(7);
+  list.insert(list.end(), 8);
+  assert(list.size() == n);
+
+  List<uint32_t> other;
+  auto first = list.begin();
+  auto last = list.begin();
+  for (int i = 0; i < 100; ++i) ++last;
+  other.splice(other.end(), list, first, last);
+  assert(other.size() == 100 && list.size() == n - 100);
+
+  List<uint32_t> copy(list);
+  assert(copy.size() == list.size());
+  copy = other;
+  assert(copy.size() == 100 && copy.front() == 7);
+
+  // tear down in the opposite order the batches were shared
+  list.clear();
+  assert(list.empty() && list.begin() == list.end());
+  other.sort();
+  other.clear();
+
+  list.append(values, values + 10);
+  assert(list.size() == 10 && list.front() == 0);
+
+  // short ranges and copies of them, around the plain node threshold and a batch
+  size_t sizes[] = { 1, 3, 15, 16, 17, 600, 1500 };
+  for (size_t k : sizes) {
+    List<uint32_t> small(values, k);
+    List<uint32_t> copy(small);
+    assert(copy.size() == k && copy.front() == 0);
+    copy.erase(copy.begin());
+    copy.append(values, values + k);
+    assert(copy.size() == 2 * k - 1 && (k == 1 || copy.front() == 1));
+    small = copy;
+    small.pop_back();
+    copy.clear();
+    assert(small.size() == 2 * k - 2);
+  }
+
+  return 0;
+}
+
 int main(void) {
   return testPushBack()
-    | testPushFront();
+    | testPushFront()
+    | testIntrusive()
+    | testChunked()
+    | testSpliceMergeSort()
+    | testBulk();
 }
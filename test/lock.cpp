@@ -0,0 +1,204 @@
+#include <bmcpp/lock.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <pthread.h>
+
+using BmCpp::SpinLock;
+using BmCpp::TicketLock;
+using BmCpp::McsLock;
+using BmCpp::AdaptiveMutex;
+using BmCpp::SeqLocked;
+using BmCpp::LockGuard;
+using BmCpp::LockStats;
+using std::size_t;
+
+enum { THREADS = 4, ITERATIONS = 10000 };
+
+template<typename L>
+struct Shared {
+  L lock;
+  uint64_t counter;
+};
+
+template<typename L>
+void* hammer(void* arg) {
+  Shared<L>* s = static_cast<Shared<L>*>(arg);
+  for (int i = 0; i < ITERATIONS; ++i) {
+    LockGuard<L> g(s->lock);
+    // not atomic on purpose: a broken lock loses increments
+    uint64_t v = s->counter;
+    s->counter = v + 1;
+  }
+  return nullptr;
+}
+
+template<typename T>
+void* hammerMcs(void* arg) {
+  Shared<McsLock<T>>* s = static_cast<Shared<McsLock<T>>*>(arg);
+  for (int i = 0; i < ITERATIONS; ++i) {
+    typename McsLock<T>::Guard g(s->lock);
+    uint64_t v = s->counter;
+    s->counter = v + 1;
+  }
+  return nullptr;
+}
+
+template<typename L>
+uint64_t run(Shared<L>& s, void* (*fn)(void*)) {
+  s.counter = 0;
+  pthread_t t[THREADS];
+  for (int i = 0; i < THREADS; ++i)
+    pthread_create(&t[i], nullptr, fn, &s);
+  for (int i = 0; i < THREADS; ++i)
+    pthread_join(t[i], nullptr);
+  return s.counter;
+}
+
+int testMutualExclusion() {
+  const uint64_t total = uint64_t(THREADS) * ITERATIONS;
+
+  Shared<SpinLock<>> spin;
+  assert(run(spin, hammer<SpinLock<>>) == total);
+  Shared<TicketLock<>> ticket;
+  assert(run(ticket, hammer<TicketLock<>>) == total);
+  Shared<McsLock<>> mcs;
+  assert(run(mcs, hammerMcs<BmCpp::NoLockStats>) == total);
+  Shared<AdaptiveMutex<>> adaptive;
+  assert(run(adaptive, hammer<AdaptiveMutex<>>) == total);
+  return 0;
+}
+
+int testTryLock() {
+  SpinLock<> s;
+  assert(s.tryLock() && !s.tryLock());
+  s.unlock();
+
+  TicketLock<> t;
+  assert(t.tryLock() && !t.tryLock());
+  t.unlock();
+  assert(t.tryLock());
+  t.unlock();
+
+  McsLock<> m;
+  McsLock<>::Node a, b;
+  assert(m.tryLock(a) && !m.tryLock(b));
+  m.unlock(a);
+  assert(m.tryLock(b));
+  m.unlock(b);
+
+  AdaptiveMutex<> am;
+  assert(am.tryLock() && !am.tryLock());
+  am.unlock();
+  return 0;
+}
+
+int testStats() {
+  const uint64_t total = uint64_t(THREADS) * ITERATIONS;
+
+  Shared<SpinLock<LockStats>> spin;
+  run(spin, hammer<SpinLock<LockStats>>);
+  assert(spin.lock.stats().acquisitions() == total);
+  assert(spin.lock.stats().contentions() <= total);
+  assert(spin.lock.stats().maxWaitNs() <= spin.lock.stats().waitNs());
+
+  Shared<McsLock<LockStats>> mcs;
+  run(mcs, hammerMcs<LockStats>);
+  assert(mcs.lock.stats().acquisitions() == total);
+
+  Shared<AdaptiveMutex<LockStats>> adaptive;
+  run(adaptive, hammer<AdaptiveMutex<LockStats>>);
+  assert(adaptive.lock.stats().acquisitions() == total);
+  adaptive.lock.stats().reset();
+  assert(adaptive.lock.stats().acquisitions() == 0);
+
+  // one thread never waits
+  TicketLock<LockStats> t;
+  for (int i = 0; i < 10; ++i) {
+    t.lock();
+    t.unlock();
+  }
+  assert(t.stats().acquisitions() == 10 && t.stats().contentions() == 0);
+
+  // a successful tryLock() counts as an acquisition on every lock, a failed one does not
+  SpinLock<LockStats> ts;
+  TicketLock<LockStats> tt;
+  McsLock<LockStats> tm;
+  McsLock<LockStats>::Node n1, n2;
+  AdaptiveMutex<LockStats> ta;
+  assert(ts.tryLock() && !ts.tryLock());
+  assert(tt.tryLock() && !tt.tryLock());
+  assert(tm.tryLock(n1) && !tm.tryLock(n2));
+  assert(ta.tryLock() && !ta.tryLock());
+  ts.unlock();
+  tt.unlock();
+  tm.unlock(n1);
+  ta.unlock();
+  assert(ts.stats().acquisitions() == 1 && tt.stats().acquisitions() == 1);
+  assert(tm.stats().acquisitions() == 1 && ta.stats().acquisitions() == 1);
+  return 0;
+}
+
+struct Pair {
+  uint64_t a;
+  uint64_t b;
+  uint32_t c;
+};
+
+struct SeqShared {
+  SeqLocked<Pair> value;
+  std::atomic<bool> stop;
+  std::atomic<uint64_t> reads;
+};
+
+void* seqWriter(void* arg) {
+  SeqShared* s = static_cast<SeqShared*>(arg);
+  for (uint64_t i = 1; i <= 20000; ++i) {
+    Pair p = { i, ~i, uint32_t(i) };
+    s->value.store(p);
+    if (i % 64 == 0)
+      sched_yield();
+  }
+  s->stop.store(true);
+  return nullptr;
+}
+
+void* seqReader(void* arg) {
+  SeqShared* s = static_cast<SeqShared*>(arg);
+  while (!s->stop.load()) {
+    Pair p = s->value.load();
+    // never a torn value
+    assert(p.b == ~p.a && p.c == uint32_t(p.a));
+    s->reads.fetch_add(1);
+    sched_yield();
+  }
+  return nullptr;
+}
+
+int testSeqLock() {
+  Pair init = { 0, ~uint64_t(0), 0 };
+  SeqShared s;
+  s.value.store(init);
+  s.stop.store(false);
+  s.reads.store(0);
+
+  pthread_t w, r[2];
+  pthread_create(&r[0], nullptr, seqReader, &s);
+  pthread_create(&r[1], nullptr, seqReader, &s);
+  pthread_create(&w, nullptr, seqWriter, &s);
+  pthread_join(w, nullptr);
+  pthread_join(r[0], nullptr);
+  pthread_join(r[1], nullptr);
+
+  assert(s.value.load().a == 20000);
+  return 0;
+}
+
+int main() {
+  int r = testMutualExclusion();
+  r |= testTryLock();
+  r |= testStats();
+  r |= testSeqLock();
+  return r;
+}
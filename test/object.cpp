@@ -0,0 +1,175 @@
+#include <bmcpp/object.hpp>
+#include <bmcpp/array.hpp>
+
+#include <pthread.h>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::Object;
+using BmCpp::LocalObject;
+using BmCpp::ObjectPtr;
+using BmCpp::ConstObjectPtr;
+using BmCpp::WeakObjectPtr;
+using BmCpp::Array;
+using std::size_t;
+
+static std::atomic<int> alive(0);
+
+struct Shared : Object {
+  Shared() { ++alive; }
+  ~Shared() override { --alive; }
+};
+
+struct Derived : Shared {};
+
+struct Local : LocalObject {
+  explicit Local(int v) : v(v) { ++alive; }
+  ~Local() override { --alive; }
+  int v;
+};
+
+static ObjectPtr<Shared> make() {
+  return ObjectPtr<Shared>(new Shared());
+}
+
+int testMove() {
+  ObjectPtr<Shared> a = make();
+  assert(a->getRefCount() == 1);
+
+  ObjectPtr<Shared> b(static_cast<ObjectPtr<Shared> &&>(a));
+  assert(!a && b->getRefCount() == 1);
+
+  ObjectPtr<Shared> c;
+  c = static_cast<ObjectPtr<Shared> &&>(b);
+  assert(!b && c->getRefCount() == 1);
+
+  ObjectPtr<Shared> d(ObjectPtr<Derived>(new Derived()));
+  assert(d->getRefCount() == 1 && alive == 2);
+
+  ConstObjectPtr<Shared> e(static_cast<ObjectPtr<Shared> &&>(c));
+  assert(!c && e->getRefCount() == 1);
+  ConstObjectPtr<Shared> f(static_cast<ConstObjectPtr<Shared> &&>(e));
+  assert(!e && f->getRefCount() == 1);
+
+  // relocation inside an Array moves the pointers, the counts stay at one
+  Array<ObjectPtr<Shared>> arr;
+  for (size_t i = 0; i < 20; ++i)
+    arr.pushBack(make());
+  for (size_t i = 0; i < arr.size(); ++i)
+    assert(arr[i]->getRefCount() == 1);
+
+  arr.clear();
+  d.reset();
+  f = ConstObjectPtr<Shared>();
+  assert(alive == 0);
+  return 0;
+}
+
+int testAdopt() {
+  Shared *raw = new Shared();
+  raw->grab();
+  ObjectPtr<Shared> p = ObjectPtr<Shared>::adopt(raw);
+  assert(p->getRefCount() == 1);
+
+  Shared *back = p.detach();
+  assert(!p && back == raw && back->getRefCount() == 1);
+
+  ConstObjectPtr<Shared> c = ConstObjectPtr<Shared>::adopt(back);
+  assert(c->getRefCount() == 1);
+  c = ConstObjectPtr<Shared>();
+  assert(alive == 0);
+  return 0;
+}
+
+int testLocal() {
+  ObjectPtr<Local> a(new Local(7));
+  ObjectPtr<Local> b = a;
+  assert(a->getRefCount() == 2 && b->v == 7);
+  a.reset();
+  assert(b->getRefCount() == 1 && alive == 1);
+  b.reset();
+  assert(alive == 0);
+  return 0;
+}
+
+int testWeak() {
+  ObjectPtr<Shared> strong(new Shared());
+  WeakObjectPtr<Shared> weak(strong);
+  WeakObjectPtr<Shared> copy = weak;
+  assert(!weak.expired());
+  // strong and weak counts share one word next to the vtable pointer
+  assert(sizeof(Object) == sizeof(void *) + sizeof(uint64_t));
+
+  {
+    ObjectPtr<Shared> locked = copy.lock();
+    assert(locked == strong && strong->getRefCount() == 2);
+  }
+
+  // the object goes with the last strong reference, the weak ones keep the storage
+  strong.reset();
+  assert(alive == 0);
+  assert(weak.expired() && !weak.lock() && !copy.lock());
+  // weak references to a dead object can still be copied and dropped
+  WeakObjectPtr<Shared> late = weak;
+  assert(late.expired());
+  copy.reset();
+  weak.reset();
+  late.reset();
+
+  // local objects follow the same rules
+  ObjectPtr<Local> local(new Local(3));
+  WeakObjectPtr<Local> localWeak(local);
+  assert(localWeak.lock()->v == 3);
+  local.reset();
+  assert(alive == 0 && localWeak.expired());
+  return 0;
+}
+
+struct Upgrader {
+  WeakObjectPtr<Shared> weak;
+  std::atomic<bool> *stop;
+  size_t upgrades;
+};
+
+static void *upgrade(void *arg) {
+  Upgrader *u = static_cast<Upgrader *>(arg);
+  while (!u->stop->load()) {
+    ObjectPtr<Shared> s = u->weak.lock();
+    if (s) {
+      assert(s->getRefCount() >= 1);
+      ++u->upgrades;
+    }
+  }
+  return nullptr;
+}
+
+int testWeakConcurrent() {
+  for (size_t round = 0; round < 20; ++round) {
+    ObjectPtr<Shared> strong(new Shared());
+    std::atomic<bool> stop(false);
+    Upgrader args[3];
+    pthread_t threads[3];
+    for (size_t i = 0; i < 3; ++i) {
+      args[i].weak = strong;
+      args[i].stop = &stop;
+      args[i].upgrades = 0;
+      pthread_create(&threads[i], nullptr, upgrade, &args[i]);
+    }
+    for (volatile size_t spin = 0; spin < 10000; ++spin) {}
+    strong.reset();
+    stop.store(true);
+    for (size_t i = 0; i < 3; ++i)
+      pthread_join(threads[i], nullptr);
+    assert(alive == 0);
+  }
+  return 0;
+}
+
+int main(void) {
+  return testMove()
+    | testAdopt()
+    | testLocal()
+    | testWeak()
+    | testWeakConcurrent();
+}
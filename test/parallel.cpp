@@ -0,0 +1,186 @@
+#include <bmcpp/parallel.hpp>
+#include <bmcpp/string.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::ThreadPool;
+using BmCpp::Array;
+using BmCpp::HashMap;
+using BmCpp::HashSet;
+using BmCpp::parallelFor;
+using BmCpp::parallelReduce;
+using BmCpp::parallelForeach;
+using BmCpp::parallelTransform;
+using BmCpp::parallelSort;
+using BmCpp::ObjectPtr;
+using BmCpp::String;
+using std::size_t;
+
+int testFor() {
+  ThreadPool pool(4);
+  const size_t n = 100003;
+  Array<uint32_t> a;
+  a.resize(n);
+
+  parallelFor(pool, 0, n, [&a](size_t lo, size_t hi) {
+    for (size_t i = lo; i < hi; ++i)
+      a[i] += uint32_t(i);
+  });
+  for (size_t i = 0; i < n; ++i)
+    assert(a[i] == i);
+
+  // explicit grain, odd bounds
+  std::atomic<size_t> chunks(0);
+  parallelFor(pool, 7, 1007, [&chunks](size_t lo, size_t hi) {
+    assert(hi - lo <= 100 && lo >= 7 && hi <= 1007);
+    chunks.fetch_add(1);
+  }, 100);
+  assert(chunks.load() == 10);
+
+  uint64_t sum = parallelReduce(pool, 0, n, uint64_t(0), [&a](size_t lo, size_t hi) {
+    uint64_t s = 0;
+    for (size_t i = lo; i < hi; ++i)
+      s += a[i];
+    return s;
+  }, [](uint64_t x, uint64_t y) { return x + y; });
+  assert(sum == uint64_t(n) * (n - 1) / 2);
+
+  uint32_t maxValue = parallelReduce(pool, a, uint32_t(0),
+    [](uint32_t acc, uint32_t v) { return v > acc ? v : acc; },
+    [](uint32_t x, uint32_t y) { return x > y ? x : y; }, 1000);
+  assert(maxValue == n - 1);
+
+  assert(parallelReduce(pool, 5, 5, 42, [](size_t, size_t) { return 0; },
+                        [](int x, int y) { return x + y; }) == 42);
+  return 0;
+}
+
+int testArrays() {
+  ThreadPool pool(3);
+  const size_t n = 50000;
+  Array<uint8_t> bytes;
+  bytes.resize(n);
+
+  // small elements: chunks are cache line aligned, no two tasks share a line
+  parallelForeach(pool, bytes, [](uint8_t &b) { b += 1; }, 1000);
+  for (size_t i = 0; i < n; ++i)
+    assert(bytes[i] == 1);
+
+  BmCpp::Detail::Chunks chunks(bytes.get(), 1, n, 1000);
+  for (size_t i = 1; i < chunks.count; ++i) {
+    size_t b = chunks.begin(i);
+    assert(b == n || reinterpret_cast<uintptr_t>(&bytes[b]) % BmCpp::CACHE_LINE_SIZE == 0);
+    assert(chunks.end(i - 1) == b);
+  }
+
+  Array<double> halves;
+  parallelTransform(pool, bytes, halves, [](uint8_t b) { return b / 2.0; });
+  assert(halves.size() == n);
+  for (size_t i = 0; i < n; ++i)
+    assert(halves[i] == 0.5);
+  return 0;
+}
+
+int testHash() {
+  ThreadPool pool(4);
+  HashMap<uint32_t, uint64_t> map;
+  HashSet<uint32_t> set;
+  for (uint32_t i = 0; i < 20000; ++i) {
+    map.set(i, i);
+    set.add(i);
+  }
+  assert(map.capacity() >= map.count());
+
+  parallelForeach(pool, map, [](const uint32_t &k, uint64_t *v) { *v += k; });
+
+  std::atomic<uint64_t> sum(0);
+  const HashMap<uint32_t, uint64_t> &cmap = map;
+  parallelForeach(pool, cmap, [&sum](const uint32_t &k, const uint64_t &v) {
+    assert(v == 2ull * k);
+    sum.fetch_add(v);
+  }, 64);
+  assert(sum.load() == 2ull * 19999 * 20000 / 2);
+
+  std::atomic<size_t> seen(0);
+  parallelForeach(pool, set, [&seen](const uint32_t &) { seen.fetch_add(1); });
+  assert(seen.load() == 20000);
+  return 0;
+}
+
+int testSort() {
+  ThreadPool pool(4);
+  uint32_t x = 2463534242u;
+  const size_t sizes[] = { 10, 100000, 250007 };
+  for (size_t s = 0; s < 3; ++s) {
+    Array<uint32_t> a;
+    uint64_t sum = 0;
+    for (size_t i = 0; i < sizes[s]; ++i) {
+      x ^= x << 13;
+      x ^= x >> 17;
+      x ^= x << 5;
+      a.pushBack(x % 5000);
+      sum += x % 5000;
+    }
+    // small grain forces several merge rounds and split merges
+    if (s == 2)
+      parallelSort(pool, a, BmCpp::Less<uint32_t>(), 1000);
+    else
+      parallelSort(pool, a);
+    assert(a.size() == sizes[s]);
+    for (size_t i = 1; i < a.size(); ++i) {
+      assert(a[i - 1] <= a[i]);
+      sum -= a[i - 1];
+    }
+    assert(sum == a[a.size() - 1]);
+  }
+  return 0;
+}
+
+// moving one of these leaves the source empty, so a merge that reads an element
+// after a sibling task moved it would see null
+struct Box : BmCpp::Object {
+  explicit Box(uint32_t v) : v(v) {}
+  uint32_t v;
+};
+
+struct BoxLess {
+  bool operator()(const ObjectPtr<Box> &a, const ObjectPtr<Box> &b) const { return a->v < b->v; }
+};
+
+struct StringLess {
+  bool operator()(const String &a, const String &b) const { return a.compare(b) < 0; }
+};
+
+int testSortMoveOnly() {
+  ThreadPool pool(4);
+  uint32_t x = 88172645u;
+  Array<ObjectPtr<Box>> boxes;
+  Array<String> strings;
+  for (size_t i = 0; i < 40000; ++i) {
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    boxes.pushBack(ObjectPtr<Box>(new Box(x % 100000)));
+    strings.pushBack(BmCpp::toString(uint64_t(x % 100000)));
+  }
+
+  parallelSort(pool, boxes, BoxLess(), 1000);
+  parallelSort(pool, strings, StringLess(), 1000);
+  assert(boxes.size() == 40000 && strings.size() == 40000);
+  for (size_t i = 0; i < boxes.size(); ++i) {
+    assert(boxes[i] && boxes[i]->getRefCount() == 1);
+    assert(i == 0 || boxes[i - 1]->v <= boxes[i]->v);
+    assert(i == 0 || strings[i - 1].compare(strings[i]) <= 0);
+  }
+  return 0;
+}
+
+int main(void) {
+  return testFor()
+    | testArrays()
+    | testHash()
+    | testSort()
+    | testSortMoveOnly();
+}
@@ -0,0 +1,139 @@
+#include <bmcpp/pool.hpp>
+#include <bmcpp/queue.hpp>
+
+#include <pthread.h>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <cstring>
+
+using BmCpp::PooledObject;
+using BmCpp::ObjectPool;
+using BmCpp::PoolStats;
+using BmCpp::ObjectPtr;
+using BmCpp::WeakObjectPtr;
+using BmCpp::MpscQueue;
+using std::size_t;
+
+static std::atomic<int> alive(0);
+
+struct Message : PooledObject<Message> {
+  explicit Message(uint32_t id) : id(id) { alive.fetch_add(1); }
+  ~Message() override { alive.fetch_sub(1); }
+  uint32_t id;
+  char payload[40];
+};
+
+struct Session : PooledObject<Session> {
+  uint64_t values[8];
+};
+
+// derives from a pooled type without a pool of its own
+struct BigMessage : Message {
+  explicit BigMessage(uint32_t id) : Message(id) { memset(extra, 0xab, sizeof(extra)); }
+  char extra[256];
+};
+
+int testRecycle() {
+  Message *first = new Message(1);
+  delete first;
+  // the block comes straight back from the thread cache
+  Message *second = new Message(2);
+  assert(second == first);
+  second->grab();
+  second->release();
+
+  const size_t n = 1000;
+  static Message *live[n];
+  for (size_t round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < n; ++i)
+      live[i] = new Message(uint32_t(i));
+    for (size_t i = 0; i < n; ++i)
+      delete live[i];
+  }
+  // only the first round went to malloc
+  PoolStats s = Message::poolStats();
+  assert(s.blocks == n);
+  assert(s.flushes > 0 && s.refills > 0);
+  assert(alive.load() == 0);
+
+  // each type has its own pool
+  delete new Session();
+  assert(Session::poolStats().blocks == 1);
+  return 0;
+}
+
+int testDerived() {
+  size_t before = ObjectPool<Message>::stats().blocks;
+  BigMessage *big = new BigMessage(9);
+  assert(big->id == 9 && big->extra[255] == char(0xab));
+  assert(ObjectPool<Message>::stats().blocks == before + 1);
+  delete big;
+
+  // the weak path frees through the pool as well
+  ObjectPtr<Message> strong(new BigMessage(10));
+  WeakObjectPtr<Message> weak(strong);
+  strong.reset();
+  assert(weak.expired());
+  weak.reset();
+
+  // the bigger blocks are reused as ordinary ones
+  Message *m = new Message(11);
+  delete m;
+  return 0;
+}
+
+int testWeak() {
+  ObjectPtr<Message> strong(new Message(7));
+  WeakObjectPtr<Message> weak(strong);
+  Message *raw = strong.get();
+  strong.reset();
+  assert(alive.load() == 0 && !weak.lock());
+  // the storage only goes back to the pool with the last weak reference
+  weak.reset();
+  Message *again = new Message(8);
+  assert(again == raw);
+  delete again;
+  return 0;
+}
+
+static const uint32_t MESSAGES = 50000;
+
+static void *producer(void *arg) {
+  MpscQueue<ObjectPtr<Message>> *q = static_cast<MpscQueue<ObjectPtr<Message>> *>(arg);
+  for (uint32_t i = 0; i < MESSAGES; ++i)
+    q->push(ObjectPtr<Message>(new Message(i)));
+  return nullptr;
+}
+
+int testCrossThread() {
+  MpscQueue<ObjectPtr<Message>> q;
+  pthread_t threads[2];
+  for (size_t i = 0; i < 2; ++i)
+    pthread_create(&threads[i], nullptr, producer, &q);
+
+  // freed here, allocated there: blocks migrate through the depot
+  size_t received = 0;
+  while (received < 2 * MESSAGES) {
+    ObjectPtr<Message> m;
+    if (q.tryPop(m))
+      ++received;
+  }
+  for (size_t i = 0; i < 2; ++i)
+    pthread_join(threads[i], nullptr);
+  assert(alive.load() == 0);
+
+  PoolStats s = Message::poolStats();
+  assert(s.blocks < 2 * MESSAGES);
+
+  ObjectPool<Message>::trim();
+  assert(Message::poolStats().depotFree == 0);
+  return 0;
+}
+
+int main(void) {
+  return testRecycle()
+    | testDerived()
+    | testWeak()
+    | testCrossThread();
+}
@@ -0,0 +1,224 @@
+#include <bmcpp/queue.hpp>
+#include <bmcpp/object.hpp>
+
+#include <pthread.h>
+#include <sched.h>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::SpscQueue;
+using BmCpp::MpscQueue;
+using BmCpp::MpmcQueue;
+using BmCpp::MpscHook;
+using BmCpp::IntrusiveMpscQueue;
+using BmCpp::Object;
+using BmCpp::ObjectPtr;
+using std::size_t;
+
+static const uint32_t ITEMS = 200000;
+static const size_t PRODUCERS = 4;
+
+static void *spscProducer(void *arg) {
+  SpscQueue<uint32_t> *q = static_cast<SpscQueue<uint32_t> *>(arg);
+  for (uint32_t i = 0; i < ITEMS; ++i)
+    while (!q->tryPush(i))
+      sched_yield();
+  return nullptr;
+}
+
+int testSpsc() {
+  SpscQueue<uint32_t> q(100);
+  assert(q.capacity() == 128);
+
+  pthread_t producer;
+  pthread_create(&producer, nullptr, spscProducer, &q);
+  for (uint32_t i = 0; i < ITEMS; ++i) {
+    uint32_t v;
+    while (!q.tryPop(v))
+      sched_yield();
+    assert(v == i);
+  }
+  pthread_join(producer, nullptr);
+
+  uint32_t v;
+  assert(!q.tryPop(v) && q.sizeApprox() == 0);
+  return 0;
+}
+
+struct Message : Object {
+  Message(uint32_t producer, uint32_t seq) : producer(producer), seq(seq) { live.fetch_add(1); }
+  ~Message() override { live.fetch_sub(1); }
+  uint32_t producer;
+  uint32_t seq;
+  MpscHook hook;
+  static std::atomic<int> live;
+};
+std::atomic<int> Message::live(0);
+
+struct ProducerArg {
+  MpscQueue<ObjectPtr<Message>> *values;
+  IntrusiveMpscQueue<Message, &Message::hook> *intrusive;
+  uint32_t id;
+};
+
+static void *mpscProducer(void *arg) {
+  ProducerArg *a = static_cast<ProducerArg *>(arg);
+  for (uint32_t i = 0; i < ITEMS; ++i) {
+    if (i & 1) {
+      a->values->push(ObjectPtr<Message>(new Message(a->id, i)));
+    } else {
+      // the intrusive queue holds one reference, taken here and dropped by the consumer
+      Message *m = new Message(a->id, i);
+      m->grab();
+      a->intrusive->push(*m);
+    }
+  }
+  return nullptr;
+}
+
+int testMpsc() {
+  MpscQueue<ObjectPtr<Message>> values;
+  IntrusiveMpscQueue<Message, &Message::hook> intrusive;
+  assert(values.empty() && intrusive.empty());
+
+  pthread_t threads[PRODUCERS];
+  ProducerArg args[PRODUCERS];
+  for (uint32_t p = 0; p < PRODUCERS; ++p) {
+    args[p].values = &values;
+    args[p].intrusive = &intrusive;
+    args[p].id = p;
+    pthread_create(&threads[p], nullptr, mpscProducer, &args[p]);
+  }
+
+  // per producer FIFO order must hold in both queues
+  uint32_t nextOdd[PRODUCERS] = { 1, 1, 1, 1 };
+  uint32_t nextEven[PRODUCERS] = { 0, 0, 0, 0 };
+  size_t received = 0;
+  while (received < PRODUCERS * ITEMS) {
+    ObjectPtr<Message> m;
+    if (values.tryPop(m)) {
+      assert(m->seq == nextOdd[m->producer]);
+      nextOdd[m->producer] += 2;
+      ++received;
+    }
+    if (Message *r = intrusive.pop()) {
+      assert(r->seq == nextEven[r->producer]);
+      nextEven[r->producer] += 2;
+      r->release();
+      ++received;
+    }
+  }
+
+  for (size_t p = 0; p < PRODUCERS; ++p)
+    pthread_join(threads[p], nullptr);
+
+  assert(values.empty() && intrusive.empty());
+  assert(Message::live.load() == 0);
+  return 0;
+}
+
+struct MpmcArg {
+  MpmcQueue<uint64_t> *queue;
+  uint32_t id;
+  std::atomic<size_t> *remaining;
+  uint64_t sum;
+};
+
+static void *mpmcProducer(void *arg) {
+  MpmcArg *a = static_cast<MpmcArg *>(arg);
+  uint64_t batch[16];
+  uint32_t sent = 0;
+  while (sent < ITEMS) {
+    size_t n = 1 + (sent % 16);
+    if (n > ITEMS - sent)
+      n = ITEMS - sent;
+    for (size_t i = 0; i < n; ++i)
+      batch[i] = (uint64_t(a->id) << 32) | (sent + i);
+    size_t done = 0;
+    while (done < n) {
+      size_t pushed = a->queue->tryPushBatch(batch + done, n - done);
+      if (!pushed)
+        sched_yield();
+      done += pushed;
+    }
+    sent += uint32_t(n);
+  }
+  return nullptr;
+}
+
+static void *mpmcConsumer(void *arg) {
+  MpmcArg *a = static_cast<MpmcArg *>(arg);
+  uint64_t batch[32];
+  uint32_t last[PRODUCERS] = { 0, 0, 0, 0 };
+  bool seen[PRODUCERS] = { false, false, false, false };
+  while (a->remaining->load() > 0) {
+    size_t n = a->queue->tryPopBatch(batch, 32);
+    if (!n)
+      sched_yield();
+    for (size_t i = 0; i < n; ++i) {
+      uint32_t producer = uint32_t(batch[i] >> 32);
+      uint32_t seq = uint32_t(batch[i]);
+      // a single consumer sees each producer's values in increasing order
+      assert(!seen[producer] || seq > last[producer]);
+      seen[producer] = true;
+      last[producer] = seq;
+      a->sum += batch[i];
+    }
+    a->remaining->fetch_sub(n);
+  }
+  return nullptr;
+}
+
+int testMpmc() {
+  MpmcQueue<uint64_t> q(60);
+  assert(q.capacity() == 64);
+
+  // single threaded: order, full and empty
+  uint64_t in[100];
+  uint64_t out[100];
+  for (size_t i = 0; i < 100; ++i)
+    in[i] = i;
+  // empty batches return at once, whatever the state of the ring
+  assert(q.tryPushBatch(in, 0) == 0 && q.tryPopBatch(out, 0) == 0);
+  assert(q.tryPushBatch(in, 100) == 64);
+  assert(!q.tryPush(in[0]));
+  assert(q.tryPushBatch(in, 0) == 0 && q.tryPopBatch(out, 0) == 0);
+  assert(q.tryPopBatch(out, 10) == 10);
+  assert(q.tryPushBatch(in + 64, 36) == 10);
+  assert(q.tryPopBatch(out + 10, 100) == 64);
+  for (size_t i = 0; i < 74; ++i)
+    assert(out[i] == i);
+  uint64_t v;
+  assert(!q.tryPop(v));
+
+  // concurrent batches
+  std::atomic<size_t> remaining(PRODUCERS * ITEMS);
+  pthread_t threads[2 * PRODUCERS];
+  MpmcArg args[2 * PRODUCERS];
+  for (uint32_t t = 0; t < 2 * PRODUCERS; ++t) {
+    args[t].queue = &q;
+    args[t].id = t % PRODUCERS;
+    args[t].remaining = &remaining;
+    args[t].sum = 0;
+    pthread_create(&threads[t], nullptr, t < PRODUCERS ? mpmcProducer : mpmcConsumer, &args[t]);
+  }
+  for (size_t t = 0; t < 2 * PRODUCERS; ++t)
+    pthread_join(threads[t], nullptr);
+
+  uint64_t expected = 0;
+  for (uint64_t p = 0; p < PRODUCERS; ++p)
+    expected += (p << 32) * ITEMS + uint64_t(ITEMS) * (ITEMS - 1) / 2;
+  uint64_t sum = 0;
+  for (size_t t = PRODUCERS; t < 2 * PRODUCERS; ++t)
+    sum += args[t].sum;
+  assert(sum == expected);
+  assert(!q.tryPop(v));
+  return 0;
+}
+
+int main(void) {
+  return testSpsc()
+    | testMpsc()
+    | testMpmc();
+}
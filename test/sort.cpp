@@ -0,0 +1,147 @@
+#include <bmcpp/sort.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::Array;
+using BmCpp::sort;
+using BmCpp::radixSort;
+using BmCpp::lowerBound;
+using BmCpp::upperBound;
+using BmCpp::lowerBoundLinear;
+using BmCpp::binarySearch;
+using std::size_t;
+
+static uint32_t rng = 12345;
+
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+struct Greater {
+  bool operator()(int a, int b) const { return a > b; }
+};
+
+struct Record {
+  uint32_t key;
+  uint32_t order;
+};
+
+int testIntroSort() {
+  const size_t sizes[] = { 0, 1, 2, 15, 16, 17, 100, 10007 };
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+    size_t n = sizes[s];
+    Array<int> a;
+    for (size_t i = 0; i < n; ++i)
+      a.pushBack(int(next() % 1000) - 500);
+    sort(a);
+    for (size_t i = 1; i < n; ++i)
+      assert(a[i - 1] <= a[i]);
+
+    sort(a, Greater());
+    for (size_t i = 1; i < n; ++i)
+      assert(a[i - 1] >= a[i]);
+  }
+
+  // patterns that hurt a naive quicksort: sorted, reversed, all equal, organ pipe
+  const size_t n = 50000;
+  for (int pattern = 0; pattern < 4; ++pattern) {
+    Array<int> a;
+    for (size_t i = 0; i < n; ++i) {
+      switch (pattern) {
+      case 0: a.pushBack(int(i)); break;
+      case 1: a.pushBack(int(n - i)); break;
+      case 2: a.pushBack(7); break;
+      default: a.pushBack(int(i < n / 2 ? i : n - i)); break;
+      }
+    }
+    sort(a);
+    for (size_t i = 1; i < n; ++i)
+      assert(a[i - 1] <= a[i]);
+  }
+  return 0;
+}
+
+int testRadixSort() {
+  const size_t n = 20000;
+
+  Array<uint32_t> u;
+  for (size_t i = 0; i < n; ++i)
+    u.pushBack(next());
+  radixSort(u);
+  for (size_t i = 1; i < n; ++i)
+    assert(u[i - 1] <= u[i]);
+
+  Array<int64_t> s;
+  for (size_t i = 0; i < n; ++i)
+    s.pushBack((int64_t(next()) << 32 | next()) >> (i % 40));
+  radixSort(s);
+  for (size_t i = 1; i < n; ++i)
+    assert(s[i - 1] <= s[i]);
+
+  Array<float> f;
+  for (size_t i = 0; i < n; ++i)
+    f.pushBack((float(next() % 200001) - 100000.0f) / 7.0f);
+  f.pushBack(-0.0f);
+  f.pushBack(0.0f);
+  radixSort(f);
+  for (size_t i = 1; i < f.size(); ++i)
+    assert(f[i - 1] <= f[i]);
+
+  // records by key: stable, keys with only low bytes set skip the upper passes
+  Array<Record> r;
+  for (size_t i = 0; i < n; ++i) {
+    Record rec = { next() % 100, uint32_t(i) };
+    r.pushBack(rec);
+  }
+  radixSort(r, [](const Record& rec) { return rec.key; });
+  for (size_t i = 1; i < n; ++i) {
+    assert(r[i - 1].key <= r[i].key);
+    if (r[i - 1].key == r[i].key)
+      assert(r[i - 1].order < r[i].order);
+  }
+  return 0;
+}
+
+int testSearch() {
+  Array<int> a;
+  for (int i = 0; i < 1000; ++i) {
+    a.pushBack(2 * i);
+    a.pushBack(2 * i);
+  }
+
+  assert(lowerBound(a, -1) == 0);
+  assert(lowerBound(a, 0) == 0);
+  assert(upperBound(a, 0) == 2);
+  assert(lowerBound(a, 1) == 2);
+  assert(lowerBound(a, 1998) == 1998);
+  assert(upperBound(a, 1998) == 2000);
+  assert(lowerBound(a, 5000) == 2000);
+
+  for (int v = -1; v < 2001; ++v) {
+    size_t lo = lowerBound(a, v);
+    size_t hi = upperBound(a, v);
+    assert(lo == lowerBoundLinear(a.get(), a.size(), v));
+    assert(lo == 0 || a[lo - 1] < v);
+    assert(lo == a.size() || a[lo] >= v);
+    assert(hi == a.size() || a[hi] > v);
+    assert(hi - lo == (v >= 0 && v % 2 == 0 && v < 2000 ? 2u : 0u));
+    assert((binarySearch(a, v) >= 0) == (hi != lo));
+  }
+
+  Array<int> empty;
+  assert(lowerBound(empty, 3) == 0);
+  assert(binarySearch(empty, 3) == -1);
+  return 0;
+}
+
+int main() {
+  int r = testIntroSort();
+  r |= testRadixSort();
+  r |= testSearch();
+  return r;
+}
@@ -0,0 +1,253 @@
+#include <bmcpp/string.hpp>
+#include <bmcpp/hashmap.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <pthread.h>
+
+using BmCpp::String;
+using BmCpp::StringBuilder;
+using BmCpp::HashMap;
+using BmCpp::StringView;
+using std::size_t;
+
+int testConcat() {
+  String s;
+  for (size_t i = 0; i < 1000; ++i) {
+    s += "ab";
+    s += 'c';
+  }
+  assert(s.size() == 3000);
+  assert(strncmp(s.c_str(), "abcabc", 6) == 0);
+
+  String t = String("foo") + "bar" + String("baz");
+  assert(t == String("foobarbaz"));
+  assert(t.size() == 9);
+
+  return 0;
+}
+
+int testBuilder() {
+  StringBuilder sb;
+  String expected;
+  for (size_t i = 0; i < 10000; ++i) {
+    sb.append("item").appendInt(int64_t(i) - 5000).append(',');
+    char buf[32];
+    snprintf(buf, sizeof(buf), "item%d,", int(i) - 5000);
+    expected += buf;
+  }
+  assert(sb.size() == expected.size());
+  assert(sb.toString() == expected);
+
+  size_t total = 0;
+  sb.foreachChunk([&total](const char*, size_t len) { total += len; });
+  assert(total == sb.size());
+
+  sb.clear();
+  assert(sb.size() == 0);
+  sb.appendUInt(18446744073709551615ull).append(' ').appendInt(INT64_MIN);
+  assert(sb.toString() == String("18446744073709551615 -9223372036854775808"));
+
+  sb.clear();
+  sb.appendDouble(0.5);
+  assert(sb.toString() == String("0.5"));
+
+  return 0;
+}
+
+int testCompare() {
+  String a("ab\0cd", 5);
+  String b("ab\0ce", 5);
+  assert(a.size() == 5);
+  assert(a != b);
+  assert(a < b);
+  assert(!(b < a));
+  assert(String("ab") < String("abc"));
+  assert(String("abc") > String("ab"));
+  assert(String("abc") == "abc");
+  assert(String("abc") != "abd");
+
+  a += b;
+  assert(a.size() == 10);
+  assert(a == String("ab\0cdab\0ce", 10));
+
+  return 0;
+}
+
+int testHash() {
+  String s("key");
+  uint32_t h = s.hash();
+  assert(h != 0);
+  assert(h == String("key").hash());
+
+  s[0] = 'K';
+  assert(s.hash() != h);
+  s[0] = 'k';
+  assert(s.hash() == h);
+
+  s.setAt(0, 'K');
+  assert(s.hash() != h && s[0] == 'K');
+  s.setAt(0, 'k');
+  assert(s.hash() == h);
+
+  // plain char references, the cache is dropped when they are taken
+  char* p = &s[1];
+  *p = 'E';
+  assert(s.hash() == String("kEy").hash());
+  s[1] += 'e' - 'E';
+  char& c = s[1];
+  assert(c == 'e' && s.hash() == h);
+  s += "s";
+  assert(s.hash() != h);
+
+  HashMap<String, int> map;
+  char buf[32];
+  for (int i = 0; i < 1000; ++i) {
+    snprintf(buf, sizeof(buf), "key-%d", i);
+    map.set(String(buf), i);
+  }
+  assert(map.count() == 1000);
+  for (int i = 0; i < 1000; ++i) {
+    snprintf(buf, sizeof(buf), "key-%d", i);
+    int* v = map.find(String(buf));
+    assert(v && *v == i);
+  }
+  assert(map.find(String("key-1000")) == nullptr);
+
+  return 0;
+}
+
+static void *hashShared(void *arg) {
+  const String *key = static_cast<const String *>(arg);
+  uint32_t h = 0;
+  for (int i = 0; i < 1000; ++i) {
+    uint32_t v = key->hash();
+    assert(h == 0 || v == h);
+    h = v;
+  }
+  return nullptr;
+}
+
+int testSharedHash() {
+  // a const key shared between threads, hashed by all of them first thing
+  const String key("shared-key");
+  pthread_t threads[4];
+  for (pthread_t &t : threads)
+    pthread_create(&t, nullptr, hashShared, const_cast<String *>(&key));
+  for (pthread_t &t : threads)
+    pthread_join(t, nullptr);
+  assert(key.hash() == String("shared-key").hash());
+  return 0;
+}
+
+int testNumbers() {
+  assert(BmCpp::toString(0) == "0");
+  assert(BmCpp::toString(-42) == "-42");
+  assert(BmCpp::toString(18446744073709551615ull) == "18446744073709551615");
+  assert(BmCpp::toString(0.1) == "0.1");
+  assert(BmCpp::toString(1.0 / 3) == "0.3333333333333333");
+  assert(BmCpp::toString(1e21) == "1e21");
+  assert(BmCpp::toString(-2.5e-8) == "-2.5e-8");
+  assert(BmCpp::toString(123456.0) == "123456");
+
+  String csv;
+  csv.appendInt(7).append(",", 1).appendDouble(0.25).append(",", 1).appendUInt(9);
+  assert(csv == "7,0.25,9");
+
+  int64_t i = 0;
+  uint64_t u = 0;
+  assert(BmCpp::parseInt(StringView("-9223372036854775808"), i) && i == INT64_MIN);
+  assert(!BmCpp::parseInt(StringView("9223372036854775808"), i));
+  assert(!BmCpp::parseInt(StringView("12a"), i));
+  assert(!BmCpp::parseInt(StringView(""), i));
+  assert(BmCpp::parseUInt(StringView("18446744073709551615"), u) && u == UINT64_MAX);
+  assert(!BmCpp::parseUInt(StringView("18446744073709551616"), u));
+  assert(BmCpp::parseInt(StringView(csv).substr(0, 1), i) && i == 7);
+
+  double d = 0;
+  assert(BmCpp::parseDouble(StringView("0.25"), d) && d == 0.25);
+  assert(BmCpp::parseDouble(StringView("-1.5e3"), d) && d == -1500.0);
+  assert(BmCpp::parseDouble(StringView("0.30000000000000004"), d) && d == 0.1 + 0.2);
+  assert(!BmCpp::parseDouble(StringView("1e"), d));
+  assert(!BmCpp::parseDouble(StringView("abc"), d));
+
+  // shortest output always parses back to the same value
+  double values[] = { 0.1, 1.0 / 3, 5e-324, 1.7976931348623157e308, 2.2250738585072014e-308, 123.456, -0.0 };
+  for (double v : values) {
+    String s = BmCpp::toString(v);
+    assert(BmCpp::parseDouble(StringView(s), d));
+    assert(memcmp(&d, &v, sizeof(d)) == 0);
+  }
+
+  return 0;
+}
+
+// significant digits of a formatted number, without leading or trailing zeros
+static size_t significand(const char* s, char* out) {
+  size_t n = 0;
+  for (; *s && *s != 'e' && *s != 'E'; ++s)
+    if (*s >= '0' && *s <= '9' && (n || *s != '0'))
+      out[n++] = *s;
+  while (n > 1 && out[n - 1] == '0')
+    --n;
+  out[n] = '\0';
+  return n;
+}
+
+int testShortestDoubles() {
+  // the last digit is the nearest one, not just one that reads back
+  assert(BmCpp::toString(0.1 + 0.2) == "0.30000000000000004");
+  assert(BmCpp::toString(2.1201840400810929e-105) == "2.1201840400810927e-105");
+
+  uint64_t state = 88172645463325252ull;
+  size_t tested = 0, notShortest = 0;
+  while (tested < 20000) {
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    double v;
+    memcpy(&v, &state, sizeof(v));
+    if (v != v || v - v != 0)
+      continue;
+    ++tested;
+
+    String s = BmCpp::toString(v);
+    double back = strtod(s.c_str(), nullptr);
+    assert(memcmp(&back, &v, sizeof(v)) == 0);
+
+    // the shortest %.*g that reads back is the reference
+    char ref[32];
+    int precision = 1;
+    for (; precision < 17; ++precision) {
+      snprintf(ref, sizeof(ref), "%.*g", precision, v);
+      if (strtod(ref, nullptr) == v)
+        break;
+    }
+    snprintf(ref, sizeof(ref), "%.*g", precision, v);
+
+    char ours[32], theirs[32];
+    size_t n = significand(s.c_str(), ours);
+    significand(ref, theirs);
+    // grisu2 keeps clear of the exact interval bounds, so in rare cases it lands on
+    // a neighbour digit or keeps a digit or two too many; well under a percent
+    assert(n <= 17);
+    if (strcmp(ours, theirs))
+      ++notShortest;
+  }
+  assert(notShortest * 100 < tested);
+  return 0;
+}
+
+int main(void) {
+  return testConcat()
+    | testBuilder()
+    | testCompare()
+    | testHash()
+    | testSharedHash()
+    | testNumbers()
+    | testShortestDoubles();
+}
@@ -0,0 +1,106 @@
+#include <bmcpp/threadpool.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::ThreadPool;
+using BmCpp::TaskGroup;
+using BmCpp::WorkStealingDeque;
+using std::size_t;
+
+int testDeque() {
+  WorkStealingDeque<int> d(2);
+  static int values[100];
+  for (int i = 0; i < 100; ++i)
+    d.push(&values[i]);
+  // thieves take the oldest, the owner the newest
+  assert(d.steal() == &values[0]);
+  assert(d.take() == &values[99]);
+  for (int i = 98; i >= 1; --i)
+    assert(d.take() == &values[i]);
+  assert(d.empty() && !d.take() && !d.steal());
+  return 0;
+}
+
+int testGroup() {
+  ThreadPool pool(4);
+  assert(pool.size() == 4 && pool.currentWorker() == -1);
+
+  std::atomic<uint64_t> sum(0);
+  {
+    TaskGroup group(pool);
+    for (uint64_t i = 1; i <= 10000; ++i)
+      group.spawn([&sum, i]() { sum.fetch_add(i); });
+    group.wait();
+    assert(sum.load() == 10000ull * 10001 / 2);
+  }
+  return 0;
+}
+
+static uint64_t fib(ThreadPool &pool, uint64_t n) {
+  if (n < 12)
+    return n < 2 ? n : fib(pool, n - 1) + fib(pool, n - 2);
+  uint64_t a = 0;
+  uint64_t b = 0;
+  // nested groups: waiting workers run other tasks meanwhile
+  TaskGroup group(pool);
+  group.spawn([&pool, &a, n]() { a = fib(pool, n - 1); });
+  b = fib(pool, n - 2);
+  group.wait();
+  return a + b;
+}
+
+int testNested() {
+  ThreadPool pool(3);
+  uint64_t result = 0;
+  TaskGroup group(pool);
+  group.spawn([&pool, &result]() { result = fib(pool, 24); });
+  group.wait();
+  assert(result == 46368);
+  return 0;
+}
+
+int testAffinityAndShutdown() {
+  std::atomic<size_t> ran(0);
+  std::atomic<size_t> onWorker(0);
+  {
+    ThreadPool pool(2);
+    for (size_t i = 0; i < 1000; ++i) {
+      ThreadPool *p = &pool;
+      pool.submit([&ran, &onWorker, p]() {
+        if (p->currentWorker() >= 0)
+          onWorker.fetch_add(1);
+        ran.fetch_add(1);
+      }, int(i % 3) - 1);
+    }
+    // the destructor runs everything already submitted
+  }
+  assert(ran.load() == 1000 && onWorker.load() == 1000);
+  return 0;
+}
+
+int testLateSubmit() {
+  // tasks pinned to another worker while the pool shuts down must still run
+  std::atomic<size_t> followUps(0);
+  {
+    ThreadPool pool(2);
+    for (size_t i = 0; i < 500; ++i) {
+      ThreadPool *p = &pool;
+      pool.submit([&followUps, p]() {
+        sched_yield();
+        p->submit([&followUps]() { followUps.fetch_add(1); }, 1 - p->currentWorker());
+      }, int(i % 2));
+    }
+  }
+  assert(followUps.load() == 500);
+  return 0;
+}
+
+int main(void) {
+  return testDeque()
+    | testGroup()
+    | testNested()
+    | testAffinityAndShutdown()
+    | testLateSubmit();
+}
@@ -0,0 +1,137 @@
+#include <bmcpp/timer.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+using BmCpp::Timer;
+using BmCpp::TimerWheel;
+using std::size_t;
+
+static uint32_t rng = 2463534242u;
+
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+int testBasic() {
+  TimerWheel wheel(100);
+  Timer a, b, c;
+  int fired = 0;
+
+  wheel.schedule(a, 105, [&fired]() { fired |= 1; });
+  wheel.schedule(b, 200, [&fired]() { fired |= 2; });
+  wheel.schedule(c, 50, [&fired]() { fired |= 4; });	// already due
+  assert(wheel.size() == 3 && a.isScheduled());
+  assert(wheel.nextExpiry() == 101);
+
+  assert(wheel.advance(101) == 1 && fired == 4);
+  assert(wheel.advance(104) == 0);
+  assert(wheel.advance(105) == 1 && fired == 5 && !a.isScheduled());
+
+  assert(wheel.cancel(b) && !wheel.cancel(b));
+  assert(wheel.size() == 0 && wheel.nextExpiry() == UINT64_MAX);
+  assert(wheel.advance(1000) == 0 && wheel.now() == 1000);
+
+  // rescheduling moves an armed timer
+  wheel.schedule(a, 2000, [&fired]() { fired = 100; });
+  wheel.schedule(a, 1010, [&fired]() { fired = 200; });
+  assert(wheel.size() == 1);
+  assert(wheel.advance(1500) == 1 && fired == 200);
+
+  // a timer still sitting in level 1 is reported exactly, not by its slot start
+  TimerWheel late(69);
+  Timer d;
+  late.schedule(d, 133, []() {});
+  late.advance(100);
+  assert(late.nextExpiry() == 133);
+  late.cancel(d);
+  return 0;
+}
+
+struct Probe {
+  Timer timer;
+  uint64_t deadline;
+  uint64_t firedAt;
+  bool cancelled;
+};
+
+enum { N = 3000 };
+static Probe probes[N];
+
+int testRandom() {
+  TimerWheel wheel;
+
+  // spans every level and a few beyond the wheel's reach
+  for (int i = 0; i < N; ++i) {
+    Probe* p = &probes[i];
+    uint32_t shift = next() % 27;
+    p->deadline = 1 + (next() & ((1u << shift) - 1));
+    p->firedAt = 0;
+    p->cancelled = false;
+    wheel.schedule(p->timer, p->deadline, [p, &wheel]() { p->firedAt = wheel.now(); });
+  }
+  for (int i = 0; i < N; i += 7) {
+    probes[i].cancelled = true;
+    assert(wheel.cancel(probes[i].timer));
+  }
+
+  uint64_t t = 0;
+  while (wheel.size()) {
+    uint64_t next = wheel.nextExpiry();
+    assert(next > t);
+    // exactly the earliest pending deadline
+    uint64_t earliest = UINT64_MAX;
+    for (int i = 0; i < N; ++i)
+      if (probes[i].timer.isScheduled() && probes[i].deadline < earliest)
+        earliest = probes[i].deadline;
+    assert(next == earliest);
+    t = next;
+    assert(wheel.advance(t) >= 1);
+  }
+
+  for (int i = 0; i < N; ++i) {
+    if (probes[i].cancelled)
+      assert(probes[i].firedAt == 0);
+    else
+      assert(probes[i].firedAt == probes[i].deadline);
+  }
+  return 0;
+}
+
+int testCallbacks() {
+  TimerWheel wheel;
+  Timer periodic, victim;
+  int ticks = 0;
+  bool victimFired = false;
+
+  // a callback re-arming its own timer and cancelling another
+  struct Rearm {
+    TimerWheel* wheel;
+    Timer* self;
+    Timer* victim;
+    int* ticks;
+    void operator()() const {
+      if (++*ticks == 3)
+        wheel->cancel(*victim);
+      if (*ticks < 10)
+        wheel->schedule(*self, wheel->now() + 100, Rearm(*this));
+    }
+  };
+  wheel.schedule(periodic, 100, Rearm{ &wheel, &periodic, &victim, &ticks });
+  wheel.schedule(victim, 350, [&victimFired]() { victimFired = true; });
+
+  wheel.advance(5000);
+  assert(ticks == 10 && !victimFired && wheel.size() == 0);
+  return 0;
+}
+
+int main() {
+  int r = testBasic();
+  r |= testRandom();
+  r |= testCallbacks();
+  return r;
+}
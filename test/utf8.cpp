@@ -0,0 +1,141 @@
+#include <bmcpp/utf8.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <cstring>
+
+using BmCpp::Array;
+using BmCpp::String;
+using BmCpp::StringView;
+using BmCpp::Utf8View;
+using std::size_t;
+
+int testValidate() {
+  // "héllo wörld €𝄞" followed by enough ASCII to cross block boundaries
+  String s("h\xc3\xa9llo w\xc3\xb6rld \xe2\x82\xac\xf0\x9d\x84\x9e");
+  assert(BmCpp::validateUtf8(StringView(s)));
+  for (size_t i = 0; i < 40; ++i) {
+    s += 'x';
+    assert(BmCpp::validateUtf8(StringView(s)));
+  }
+
+  const char* bad[] = {
+    "\x80",                 // lone continuation
+    "\xc0\xaf",             // overlong '/'
+    "\xe0\x80\xaf",         // overlong 3 bytes
+    "\xed\xa0\x80",         // surrogate
+    "\xf4\x90\x80\x80",     // > U+10FFFF
+    "\xf5\x80\x80\x80",     // invalid lead
+    "\xe2\x82",             // truncated
+    "abc\xc3",              // truncated at the end
+  };
+  for (const char* b : bad) {
+    assert(!BmCpp::validateUtf8(StringView(b)));
+
+    // same error in the middle of a long ASCII run
+    String padded;
+    for (size_t i = 0; i < 37; ++i) padded += 'a';
+    padded += b;
+    for (size_t i = 0; i < 37; ++i) padded += 'a';
+    assert(!BmCpp::validateUtf8(StringView(padded)));
+  }
+
+  return 0;
+}
+
+static uint32_t rng = 2463534242u;
+
+static uint32_t next() {
+  rng ^= rng << 13;
+  rng ^= rng >> 17;
+  rng ^= rng << 5;
+  return rng;
+}
+
+// the block validator (SSSE3 or SSE2, depending on the build) agrees with the scalar one
+int testAgainstScalar() {
+  const char* pieces[] = {
+    "a", "0123456789abcdef", "\xc3\xa9", "\xe2\x82\xac", "\xf0\x9d\x84\x9e", "\xef\xbf\xbf",
+    "\x80", "\xc0\xaf", "\xed\xa0\x80", "\xf4\x90\x80\x80", "\xff", "\xe2\x82", "\xf0\x9d",
+  };
+  const size_t valid = 6;
+  char buf[300];
+  size_t invalid = 0;
+  for (int round = 0; round < 20000; ++round) {
+    size_t len = 0;
+    size_t target = next() % 260;
+    while (len < target) {
+      // mostly well formed text with an occasional bad piece
+      size_t k = next() % 64 == 0 ? valid + next() % (sizeof(pieces) / sizeof(pieces[0]) - valid) : next() % valid;
+      size_t l = strlen(pieces[k]);
+      memcpy(buf + len, pieces[k], l);
+      len += l;
+    }
+    if (round % 8 == 0 && len)
+      buf[next() % len] = char(next());
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(buf);
+    bool expected = BmCpp::Detail::validateScalar(p, p + len);
+    assert(BmCpp::validateUtf8(buf, len) == expected);
+    invalid += !expected;
+  }
+  assert(invalid > 1000 && invalid < 19000);
+  return 0;
+}
+
+int testIterate() {
+  StringView s("a\xc3\xa9\xe2\x82\xac\xf0\x9d\x84\x9e");
+  const uint32_t expected[] = { 'a', 0xE9, 0x20AC, 0x1D11E };
+  assert(BmCpp::countCodePoints(s) == 4);
+
+  size_t i = 0;
+  for (uint32_t cp : Utf8View(s)) {
+    assert(cp == expected[i]);
+    ++i;
+  }
+  assert(i == 4);
+
+  // invalid bytes decode as U+FFFD one at a time
+  StringView b("a\xff" "b");
+  i = 0;
+  for (uint32_t cp : Utf8View(b)) {
+    assert(cp == (i == 1 ? uint32_t(BmCpp::REPLACEMENT_CHARACTER) : uint32_t(b[i])));
+    ++i;
+  }
+  assert(i == 3);
+
+  return 0;
+}
+
+int testTranscode() {
+  String s("plain ascii prefix, then h\xc3\xa9llo \xe2\x82\xac\xf0\x9d\x84\x9e");
+
+  Array<uint32_t> u32;
+  assert(BmCpp::utf8ToUtf32(StringView(s), u32));
+  assert(u32.size() == BmCpp::countCodePoints(StringView(s)));
+  assert(u32[u32.size() - 1] == 0x1D11E);
+
+  Array<uint16_t> u16;
+  assert(BmCpp::utf8ToUtf16(StringView(s), u16));
+  assert(u16.size() == u32.size() + 1);  // one surrogate pair
+  assert(u16[u16.size() - 2] == 0xD834 && u16[u16.size() - 1] == 0xDD1E);
+
+  String back;
+  assert(BmCpp::utf32ToUtf8(u32, back) && back == s);
+  back.clear();
+  assert(BmCpp::utf16ToUtf8(u16, back) && back == s);
+
+  assert(!BmCpp::utf8ToUtf32(StringView("\xed\xa0\x80"), u32));
+  u16.resize(1);
+  u16[0] = 0xDC00;  // unpaired low surrogate
+  assert(!BmCpp::utf16ToUtf8(u16, back));
+
+  return 0;
+}
+
+int main(void) {
+  return testValidate()
+    | testAgainstScalar()
+    | testIterate()
+    | testTranscode();
+}